@@ -0,0 +1,202 @@
+// accumulation.h
+// Persistent off-screen frame for fading trails: decayed in place each frame, drawn over, blitted once
+#pragma once
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "simd.h"
+#include "thread_pool.h"
+
+// --decay gpu|cpu: fade with a translucent fill on the renderer, or with a
+// SIMD pass over a CPU copy of the frame that is read back after drawing
+inline bool parseDecayMode(int argc, char* argv[], bool& cpuDecay) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--decay") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "cpu") == 0) {
+                cpuDecay = true;
+            } else if (strcmp(value, "gpu") == 0) {
+                cpuDecay = false;
+            } else {
+                SDL_Log("Unknown decay mode '%s', expected 'gpu' or 'cpu'", value);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Fill alpha that fades by alphaPerFrame per 60 Hz frame, compounded over step frames
+inline Uint8 stepFadeAlpha(float alphaPerFrame, float step) {
+    return (Uint8)(255.0f * (1.0f - powf(1.0f - alphaPerFrame / 255.0f, step)) + 0.5f);
+}
+
+// dst - 1 per color channel, alpha kept. A black fill at alpha a leaves channels
+// below about 128 / a as they are, since blending rounds to nearest, so GPU decay
+// takes one more level off per 60 Hz frame to let trails end in black.
+inline SDL_BlendMode residueBlendMode() {
+    return SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_REV_SUBTRACT,
+                                      SDL_BLENDFACTOR_ZERO, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_ADD);
+}
+
+// Multiplier in 1/256ths matching a black fill at the given alpha
+inline Uint16 decayKeep(Uint8 fadeAlpha) {
+    return (Uint16)(((255 - fadeAlpha) * 256 + 127) / 255);
+}
+
+inline void decayRowScalar(Uint32* pixels, int count, Uint16 keep) {
+    for (int i = 0; i < count; ++i) {
+        Uint32 p = pixels[i];
+        Uint32 rb = (((p & 0xFF00FF) * keep) >> 8) & 0xFF00FF;
+        Uint32 g = (((p & 0x00FF00) * keep) >> 8) & 0x00FF00;
+        pixels[i] = rb | g;
+    }
+}
+
+#if defined(SIMD_X86)
+// Bytes widened to 16-bit lanes, scaled and narrowed back; 4 pixels per step
+SIMD_TARGET_SSE2 inline void decayRowSse2(Uint32* pixels, int count, Uint16 keep) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k = _mm_set1_epi16((short)keep);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(pixels + i));
+        __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), k), 8);
+        __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), k), 8);
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(lo, hi));
+    }
+    decayRowScalar(pixels + i, count - i, keep);
+}
+
+SIMD_TARGET_AVX2 inline void decayRowAvx2(Uint32* pixels, int count, Uint16 keep) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i k = _mm256_set1_epi16((short)keep);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(pixels + i));
+        __m256i lo = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), k), 8);
+        __m256i hi = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), k), 8);
+        _mm256_storeu_si256((__m256i*)(pixels + i), _mm256_packus_epi16(lo, hi));
+    }
+    decayRowScalar(pixels + i, count - i, keep);
+}
+#endif
+
+#if defined(SIMD_ARM)
+inline void decayRowNeon(Uint32* pixels, int count, Uint16 keep) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t v = vld1q_u8((const Uint8*)(pixels + i));
+        uint8x8_t lo = vshrn_n_u16(vmulq_n_u16(vmovl_u8(vget_low_u8(v)), keep), 8);
+        uint8x8_t hi = vshrn_n_u16(vmulq_n_u16(vmovl_u8(vget_high_u8(v)), keep), 8);
+        vst1q_u8((Uint8*)(pixels + i), vcombine_u8(lo, hi));
+    }
+    decayRowScalar(pixels + i, count - i, keep);
+}
+#endif
+
+// Scale every channel of an RGB888 row by keep/256
+inline void decayRow(SimdLevel level, Uint32* pixels, int count, Uint16 keep) {
+    switch (level) {
+#if defined(SIMD_X86)
+        case SIMD_AVX2: decayRowAvx2(pixels, count, keep); return;
+        case SIMD_SSE2: decayRowSse2(pixels, count, keep); return;
+#endif
+#if defined(SIMD_ARM)
+        case SIMD_NEON: decayRowNeon(pixels, count, keep); return;
+#endif
+        default: decayRowScalar(pixels, count, keep); return;
+    }
+}
+
+struct Accumulator {
+    int width = 0;
+    int height = 0;
+    bool cpuDecay = false;
+    SDL_Texture* target = nullptr;   // keeps the previous frame; effects draw into it
+    SDL_Texture* upload = nullptr;   // CPU decay: the decayed frame goes back through here
+    std::vector<Uint32> pixels;      // CPU decay: the frame read back after drawing
+    bool subtractResidue = false;    // GPU decay: the renderer supports residueBlendMode()
+    float residueDue = 0.0f;         // GPU decay: 60 Hz frames since the last residue pass
+};
+
+inline void clearAccumulator(SDL_Renderer* renderer, Accumulator& acc) {
+    SDL_Texture* previous = SDL_GetRenderTarget(renderer);
+    SDL_SetRenderTarget(renderer, acc.target);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderTarget(renderer, previous);
+    std::fill(acc.pixels.begin(), acc.pixels.end(), 0);
+}
+
+inline bool createAccumulator(SDL_Renderer* renderer, int width, int height, bool cpuDecay, Accumulator& acc) {
+    acc.width = width;
+    acc.height = height;
+    acc.cpuDecay = cpuDecay;
+    acc.target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (cpuDecay && acc.target) {
+        acc.upload = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, width, height);
+        acc.pixels.assign((size_t)width * height, 0);
+    }
+    if (!acc.target || (cpuDecay && !acc.upload)) {
+        SDL_Log("Accumulation texture could not be created! SDL_Error: %s", SDL_GetError());
+        return false;
+    }
+    // The software renderer has no custom blend modes; it is better served by --decay cpu anyway,
+    // whose fixed-point multiply always rounds down and so reaches black by itself
+    acc.subtractResidue = !cpuDecay && SDL_SetRenderDrawBlendMode(renderer, residueBlendMode()) == 0;
+    acc.residueDue = 0.0f;
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    clearAccumulator(renderer, acc);
+    return true;
+}
+
+inline void destroyAccumulator(Accumulator& acc) {
+    if (acc.target) SDL_DestroyTexture(acc.target);
+    if (acc.upload) SDL_DestroyTexture(acc.upload);
+    acc.target = nullptr;
+    acc.upload = nullptr;
+}
+
+// Fade what the previous frames left by alphaPerFrame per 60 Hz frame, compounded
+// over step frames, and redirect drawing into the accumulator
+inline void beginAccumulation(SDL_Renderer* renderer, Accumulator& acc, float alphaPerFrame, float step, SimdLevel level,
+                              ThreadPool& pool) {
+    Uint8 fadeAlpha = stepFadeAlpha(alphaPerFrame, step);
+    SDL_SetRenderTarget(renderer, acc.target);
+    if (acc.cpuDecay) {
+        Uint16 keep = decayKeep(fadeAlpha);
+        pool.parallelFor(acc.height, 16, [&](int row0, int row1) {
+            for (int row = row0; row < row1; ++row) {
+                decayRow(level, &acc.pixels[(size_t)row * acc.width], acc.width, keep);
+            }
+        });
+        SDL_UpdateTexture(acc.upload, NULL, acc.pixels.data(), acc.width * 4);
+        SDL_SetTextureBlendMode(acc.upload, SDL_BLENDMODE_NONE);
+        SDL_RenderCopy(renderer, acc.upload, NULL, NULL);
+    } else {
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, fadeAlpha);
+        SDL_RenderFillRect(renderer, NULL);
+        acc.residueDue += step;
+        if (acc.subtractResidue && acc.residueDue >= 1.0f) {
+            acc.residueDue -= (int)acc.residueDue;
+            SDL_SetRenderDrawBlendMode(renderer, residueBlendMode());
+            SDL_SetRenderDrawColor(renderer, 1, 1, 1, 255);
+            SDL_RenderFillRect(renderer, NULL);
+        }
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    }
+}
+
+// Draw to the screen again and blit the accumulated frame with the given blend mode
+inline void endAccumulation(SDL_Renderer* renderer, Accumulator& acc, SDL_BlendMode blend) {
+    if (acc.cpuDecay) {
+        SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGB888, acc.pixels.data(), acc.width * 4);
+    }
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_SetTextureBlendMode(acc.target, blend);
+    SDL_RenderCopy(renderer, acc.target, NULL, NULL);
+}
@@ -0,0 +1,95 @@
+// adaptive_resolution.h
+// Internal resolution for the galaxy backgrounds: shade a smaller texture and let the renderer stretch it
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdlib>
+#include <cstring>
+
+const int MAX_RESOLUTION_DIVISOR = 4; // coarsest internal resolution is 1/4 of the screen
+
+struct ResolutionOptions {
+    int divisor = 0;     // --scale N: fixed 1/N internal resolution (0 = adaptive)
+    bool linear = true;  // --filter linear|nearest: how the texture is stretched
+};
+
+inline bool parseResolutionOptions(int argc, char* argv[], ResolutionOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(argv[i], "--scale") == 0 && value) {
+            options.divisor = atoi(value);
+            ++i;
+            if (options.divisor < 0 || options.divisor > MAX_RESOLUTION_DIVISOR) {
+                SDL_Log("Invalid scale '%s', expected 0 (adaptive) to %d", value, MAX_RESOLUTION_DIVISOR);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--filter") == 0 && value) {
+            ++i;
+            if (strcmp(value, "linear") == 0) {
+                options.linear = true;
+            } else if (strcmp(value, "nearest") == 0) {
+                options.linear = false;
+            } else {
+                SDL_Log("Unknown filter '%s', expected 'linear' or 'nearest'", value);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Streaming texture covering the screen at 1/divisor resolution
+inline SDL_Texture* createBackgroundTexture(SDL_Renderer* renderer, int screenWidth, int screenHeight,
+                                           int divisor, bool linear) {
+    int width = (screenWidth + divisor - 1) / divisor;
+    int height = (screenHeight + divisor - 1) / divisor;
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!texture) {
+        SDL_Log("Background texture could not be created! SDL_Error: %s", SDL_GetError());
+        return nullptr;
+    }
+    SDL_SetTextureScaleMode(texture, linear ? SDL_ScaleModeLinear : SDL_ScaleModeNearest);
+    return texture;
+}
+
+// Once a second, coarsen the internal resolution when frames run over budget
+// and refine it when the finer level is predicted to fit comfortably.
+struct AdaptiveResolution {
+    int divisor = 2;
+    bool adaptive = true;
+    double budgetMs = 1000.0 / 60;
+    Uint64 windowStart = 0;
+    double workTotalMs = 0;
+    int frames = 0;
+
+    AdaptiveResolution() = default;
+
+    // Bench and seeded runs keep a fixed divisor so they stay comparable
+    AdaptiveResolution(const ResolutionOptions& options, bool fixed, double frameBudgetMs)
+        : divisor(options.divisor ? options.divisor : 2), adaptive(options.divisor == 0 && !fixed),
+          budgetMs(frameBudgetMs), windowStart(SDL_GetPerformanceCounter()) {}
+
+    // Feed one frame's work time; returns true when the divisor changed
+    bool update(double workMs) {
+        if (!adaptive) return false;
+        workTotalMs += workMs;
+        ++frames;
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now - windowStart < SDL_GetPerformanceFrequency()) return false;
+        double mean = workTotalMs / frames;
+        workTotalMs = 0;
+        frames = 0;
+        windowStart = now;
+        int next = divisor;
+        if (mean > 0.9 * budgetMs && divisor < MAX_RESOLUTION_DIVISOR) {
+            ++next;
+        } else if (divisor > 1) {
+            // Assume the whole frame scales with the pixel count; errs towards staying coarse
+            double finer = mean * divisor * divisor / ((divisor - 1) * (divisor - 1));
+            if (finer < 0.7 * budgetMs) --next;
+        }
+        if (next == divisor) return false;
+        divisor = next;
+        SDL_Log("Background resolution: 1/%d (%.2f ms per frame)", divisor, mean);
+        return true;
+    }
+};
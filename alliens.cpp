@@ -1,54 +1,103 @@
 // alliens.cpp
 // Combines spiral galaxy plasma, starfield, and animated aliens using SDL2 in full-screen mode
 #include <SDL2/SDL.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "effect.h"
+#include "galaxy_background.h"
+#include "quad_batch.h"
+#include "raster.h"
+#include "rng.h"
+#include "starfield.h"
 
-const int NUM_STARS = 1200;
-const int NUM_ALIENS = 8;
+namespace alliens {
 
-struct Star {
-    float x, y, z;
+const int NUM_STARS = 1200; // default for --stars
+const int NUM_ALIENS = 8;    // default for --aliens
+const int ALIEN_MIN_SIZE = 32;
+const int ALIEN_MAX_SIZE = 48;
+const int ALIEN_WIGGLE_FRAMES = 16;  // antenna positions over one wiggle period
+const double ALIEN_WIGGLE_PERIOD = 2 * M_PI / 0.05;  // the antennae move with t * 0.05
+const int ALIEN_GRAIN = 1024;        // aliens per parallel simulation task
+const float ALIEN_COVERAGE = 0.25f;  // share of the screen the heads may cover before they shrink
+
+struct AlienOptions {
+    int count = NUM_ALIENS;  // --aliens N
+    bool sprites = true;     // --alien-engine sprites|points: prebuilt atlas or per-pixel drawAlien
+    bool collisions = true;  // --alien-collisions on|off: aliens bounce off each other
 };
 
-struct Alien {
-    float x, y, angle, speed, size, phase;
-    float vx, vy; // velocity for plate movement
+// All aliens in flat arrays. Collisions are found through a uniform grid whose
+// cells are at least as wide as the largest head, so touching heads sit in neighbouring cells.
+struct AlienSwarm {
+    int count = 0;
+    int width = 0;              // screen the aliens bounce around in
+    int height = 0;
+    std::vector<float> x, y;    // head center
+    std::vector<float> vx, vy;  // pixels per 60 Hz frame
+    std::vector<float> size;    // head radius, also used for collisions
+    std::vector<float> phase;   // antenna wiggle phase
+    // The collision pass reads this step's state and writes the next one here,
+    // so the result depends neither on the alien order nor on the thread count
+    std::vector<float> nextX, nextY, nextVx, nextVy;
+    float cellSize = 1;
+    int cols = 0;
+    int rows = 0;
+    std::vector<int> cell;       // grid cell of each alien
+    std::vector<int> cellStart;  // the aliens in cell c are cellItems[cellStart[c] .. cellStart[c + 1])
+    std::vector<int> cellItems;
 };
 
-void initStar(Star& star, int screenWidth, int screenHeight) {
-    star.x = (float)(rand() % screenWidth - screenWidth / 2);
-    star.y = (float)(rand() % screenHeight - screenHeight / 2);
-    star.z = (float)(rand() % screenWidth);
-}
+// Each alien is one quad cut from an atlas with a row per integer size and a
+// column per antenna-wiggle frame
+struct AlienSprites {
+    SDL_Texture* texture = nullptr;
+    int width = 0;
+    int height = 0;
+    std::vector<SDL_Rect> cells;    // atlas rect per size and frame; the head center is
+    std::vector<SDL_Point> centers; // at centers[size] inside each cell of that size
+};
 
-// Forward declare screenWidth and screenHeight for plasmaColor
-int screenWidth = 0;
-int screenHeight = 0;
-
-Uint32 plasmaColor(int x, int y, int t) {
-    // Spiral galaxy effect without yellow core
-    float cx = 0.5f * screenWidth;
-    float cy = 0.5f * screenHeight;
-    float dx = x - cx;
-    float dy = y - cy;
-    float r = sqrtf(dx * dx + dy * dy);
-    float angle = atan2f(dy, dx);
-    // Spiral arms: modulate angle by radius and time
-    float spiral = sinf(4.0f * angle + r * 0.025f - t * 0.012f);
-    float core = expf(-r * 0.002f);
-    float arms = 0.5f + 0.5f * spiral;
-    float brightness = 0.15f * core + 0.85f * arms * core;
-    // Color: blueish/purple arms, no yellow core
-    float c = brightness;
-    Uint8 rC = (Uint8)(80 * c);
-    Uint8 gC = (Uint8)(40 * c);
-    Uint8 bC = (Uint8)(180 * c + 60 * core);
-    return (rC << 16) | (gC << 8) | bC;
+bool parseAlienOptions(int argc, char* argv[], AlienOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(argv[i], "--aliens") == 0 && value) {
+            options.count = atoi(value);
+            ++i;
+            if (options.count <= 0) {
+                SDL_Log("Invalid alien count '%s'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--alien-collisions") == 0 && value) {
+            ++i;
+            if (strcmp(value, "on") == 0) {
+                options.collisions = true;
+            } else if (strcmp(value, "off") == 0) {
+                options.collisions = false;
+            } else {
+                SDL_Log("Unknown alien collision mode '%s', expected 'on' or 'off'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--alien-engine") == 0 && value) {
+            ++i;
+            if (strcmp(value, "sprites") == 0) {
+                options.sprites = true;
+            } else if (strcmp(value, "points") == 0) {
+                options.sprites = false;
+            } else {
+                SDL_Log("Unknown alien engine '%s', expected 'sprites' or 'points'", value);
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
-void drawAlien(SDL_Renderer* renderer, float x, float y, float size, float phase, int t) {
+void drawAlien(SDL_Renderer* renderer, SpanBatch& spans, float x, float y, float size, float phase, float t) {
     // Simple animated alien: green head, two eyes, antennae
     int headRadius = (int)(size);
     int eyeRadius = (int)(size * 0.13f);
@@ -58,26 +107,14 @@ void drawAlien(SDL_Renderer* renderer, float x, float y, float size, float phase
     float antennaWiggle = sinf(t * 0.05f + phase) * size * 0.08f;
     // Head
     SDL_SetRenderDrawColor(renderer, 60, 255, 80, 255);
-    for (int dy = -headRadius; dy <= headRadius; ++dy) {
-        for (int dx = -headRadius; dx <= headRadius; ++dx) {
-            if (dx * dx + dy * dy <= headRadius * headRadius) {
-                SDL_RenderDrawPoint(renderer, (int)x + dx, (int)y + dy);
-            }
-        }
-    }
+    addDiscSpans(spans, (int)x, (int)y, (float)headRadius);
+    drawSpans(renderer, spans);
     // Eyes
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     for (int e = -1; e <= 1; e += 2) {
-        int ex = (int)x + e * eyeOffsetX;
-        int ey = (int)y - eyeOffsetY;
-        for (int dy = -eyeRadius; dy <= eyeRadius; ++dy) {
-            for (int dx = -eyeRadius; dx <= eyeRadius; ++dx) {
-                if (dx * dx + dy * dy <= eyeRadius * eyeRadius) {
-                    SDL_RenderDrawPoint(renderer, ex + dx, ey + dy);
-                }
-            }
-        }
+        addDiscSpans(spans, (int)x + e * eyeOffsetX, (int)y - eyeOffsetY, (float)eyeRadius);
     }
+    drawSpans(renderer, spans);
     // Antennae
     SDL_SetRenderDrawColor(renderer, 60, 255, 80, 255);
     for (int e = -1; e <= 1; e += 2) {
@@ -86,150 +123,422 @@ void drawAlien(SDL_Renderer* renderer, float x, float y, float size, float phase
         int ax1 = (int)(ax0 + antennaWiggle + e * antennaLen * 0.2f);
         int ay1 = (int)(ay0 - antennaLen);
         SDL_RenderDrawLine(renderer, ax0, ay0, ax1, ay1);
-        // Antenna tip
-        SDL_SetRenderDrawColor(renderer, 255, 200, 60, 255);
-        for (int dy = -eyeRadius / 2; dy <= eyeRadius / 2; ++dy) {
-            for (int dx = -eyeRadius / 2; dx <= eyeRadius / 2; ++dx) {
-                if (dx * dx + dy * dy <= (eyeRadius * eyeRadius) / 4) {
-                    SDL_RenderDrawPoint(renderer, ax1 + dx, ay1 + dy);
-                }
+        addDiscSpans(spans, ax1, ay1, (float)(eyeRadius / 2));
+    }
+    // Antenna tips
+    SDL_SetRenderDrawColor(renderer, 255, 200, 60, 255);
+    drawSpans(renderer, spans);
+}
+
+int alienSizeIndex(float size) {
+    int s = (int)size;
+    if (s < ALIEN_MIN_SIZE) s = ALIEN_MIN_SIZE;
+    if (s > ALIEN_MAX_SIZE) s = ALIEN_MAX_SIZE;
+    return s - ALIEN_MIN_SIZE;
+}
+
+// Wiggle frame nearest to drawAlien's antenna phase at time t
+int alienWiggleFrame(float phase, float t) {
+    float turns = (t * 0.05f + phase) / (2.0f * (float)M_PI);
+    int frame = (int)floorf(turns * ALIEN_WIGGLE_FRAMES + 0.5f);
+    return frame & (ALIEN_WIGGLE_FRAMES - 1);
+}
+
+// Bresenham, end points included, like SDL_RenderDrawLine
+void drawSpriteLine(Uint32* pixels, int pitch, int x0, int y0, int x1, int y1, Uint32 color) {
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    while (true) {
+        pixels[y0 * pitch + x0] = color;
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x0 += sx; }
+        if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+}
+
+// Rasterize drawAlien's head, eyes, antennae and tips once per size and wiggle
+// frame into an ARGB atlas; everything outside the shapes stays transparent
+bool buildAlienSprites(SDL_Renderer* renderer, AlienSprites& sprites) {
+    const Uint32 green = 0xFF3CFF50;
+    const Uint32 black = 0xFF000000;
+    const Uint32 amber = 0xFFFFC83C;
+    int sizes = ALIEN_MAX_SIZE - ALIEN_MIN_SIZE + 1;
+    // Row layout: each cell spans the head plus the antennae above it
+    sprites.centers.resize(sizes);
+    std::vector<int> rowY(sizes);
+    int cellW = 2 * ALIEN_MAX_SIZE + 1;
+    sprites.width = cellW * ALIEN_WIGGLE_FRAMES;
+    sprites.height = 0;
+    for (int s = 0; s < sizes; ++s) {
+        int size = ALIEN_MIN_SIZE + s;
+        int top = (int)(size * 0.5f) + (int)(size * 0.13f) / 2 + 1;
+        sprites.centers[s] = {size, size + top};
+        rowY[s] = sprites.height;
+        sprites.height += 2 * size + 1 + top;
+    }
+    std::vector<Uint32> pixels((size_t)sprites.width * sprites.height, 0);
+    sprites.cells.resize((size_t)sizes * ALIEN_WIGGLE_FRAMES);
+    for (int s = 0; s < sizes; ++s) {
+        float size = (float)(ALIEN_MIN_SIZE + s);
+        int headRadius = (int)(size);
+        int eyeRadius = (int)(size * 0.13f);
+        int eyeOffsetX = (int)(size * 0.25f);
+        int eyeOffsetY = (int)(size * 0.1f);
+        int antennaLen = (int)(size * 0.5f);
+        for (int f = 0; f < ALIEN_WIGGLE_FRAMES; ++f) {
+            SDL_Rect cell = {f * cellW, rowY[s], 2 * headRadius + 1, sprites.centers[s].y + headRadius + 1};
+            sprites.cells[(size_t)s * ALIEN_WIGGLE_FRAMES + f] = cell;
+            Uint32* origin = &pixels[(size_t)cell.y * sprites.width + cell.x];
+            int clipW = sprites.width - cell.x;
+            int x = sprites.centers[s].x;
+            int y = sprites.centers[s].y;
+            float antennaWiggle = sinf(2.0f * (float)M_PI * f / ALIEN_WIGGLE_FRAMES) * size * 0.08f;
+            fillDiscPixels(origin, sprites.width, clipW, cell.h, x, y, (float)headRadius, green);
+            for (int e = -1; e <= 1; e += 2) {
+                fillDiscPixels(origin, sprites.width, clipW, cell.h, x + e * eyeOffsetX, y - eyeOffsetY,
+                               (float)eyeRadius, black);
+            }
+            for (int e = -1; e <= 1; e += 2) {
+                int ax0 = x + e * (eyeOffsetX / 2);
+                int ay0 = y - headRadius;
+                int ax1 = (int)(ax0 + antennaWiggle + e * antennaLen * 0.2f);
+                int ay1 = (int)(ay0 - antennaLen);
+                drawSpriteLine(origin, sprites.width, ax0, ay0, ax1, ay1, green);
+                fillDiscPixels(origin, sprites.width, clipW, cell.h, ax1, ay1, (float)(eyeRadius / 2), amber);
             }
         }
-        SDL_SetRenderDrawColor(renderer, 60, 255, 80, 255);
     }
+    sprites.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                        sprites.width, sprites.height);
+    if (!sprites.texture) {
+        SDL_Log("Alien sprite atlas could not be created! SDL_Error: %s", SDL_GetError());
+        return false;
+    }
+    SDL_UpdateTexture(sprites.texture, NULL, pixels.data(), sprites.width * 4);
+    SDL_SetTextureBlendMode(sprites.texture, SDL_BLENDMODE_BLEND);
+    // Exact at 1:1, and smooths the aliens scaled below the smallest size
+    SDL_SetTextureScaleMode(sprites.texture, SDL_ScaleModeLinear);
+    SDL_Log("Alien sprites: %d sizes x %d frames in %dx%d", sizes, ALIEN_WIGGLE_FRAMES, sprites.width, sprites.height);
+    return true;
 }
 
-int main(int argc, char* argv[]) {
-    srand((unsigned int)time(nullptr));
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        SDL_Log("SDL could not initialize! SDL_Error: %s", SDL_GetError());
-        return 1;
-    }
-
-    SDL_DisplayMode displayMode;
-    if (SDL_GetCurrentDisplayMode(0, &displayMode) != 0) {
-        SDL_Log("Could not get display mode! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
-    }
-    screenWidth = displayMode.w;
-    screenHeight = displayMode.h;
-
-    SDL_Window* window = SDL_CreateWindow(
-        "Aliens in the Galaxy",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        screenWidth,
-        screenHeight,
-        SDL_WINDOW_FULLSCREEN
-    );
-    if (!window) {
-        SDL_Log("Window could not be created! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
-    }
-
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, screenWidth, screenHeight);
-
-    // Kiosk-like settings
-    SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
-    SDL_SetWindowBordered(window, SDL_FALSE);
-    SDL_SetWindowAlwaysOnTop(window, SDL_TRUE);
-    SDL_SetWindowGrab(window, SDL_TRUE);
-    SDL_ShowCursor(SDL_DISABLE);
-    SDL_RaiseWindow(window);
-    SDL_SetHint(SDL_HINT_GRAB_KEYBOARD, "1");
-    SDL_SetWindowInputFocus(window);
-
-    Star stars[NUM_STARS];
-    for (int i = 0; i < NUM_STARS; ++i) {
-        initStar(stars[i], screenWidth, screenHeight);
-    }
-
-    Alien aliens[NUM_ALIENS];
-    for (int i = 0; i < NUM_ALIENS; ++i) {
-        float angle = (2 * M_PI * i) / NUM_ALIENS;
-        aliens[i].x = screenWidth / 2 + cosf(angle) * screenWidth * 0.3f;
-        aliens[i].y = screenHeight / 2 + sinf(angle) * screenHeight * 0.18f;
-        aliens[i].angle = angle;
-        aliens[i].speed = 0.002f + 0.001f * (rand() % 100) / 100.0f;
-        aliens[i].size = 32.0f + 16.0f * (rand() % 100) / 100.0f;
-        aliens[i].phase = (float)(rand() % 1000) / 100.0f;
+// One quad per alien, filled by the workers. Aliens of an atlas size are placed at
+// whole-pixel coordinates, so the atlas maps 1:1 onto the screen; smaller ones
+// scale the smallest size down.
+void addAlienSprites(QuadBatch& batch, const AlienSprites& sprites, const AlienSwarm& swarm, float t,
+                     ThreadPool& pool) {
+    size_t first = batch.vertices.size();
+    batch.vertices.resize(first + (size_t)swarm.count * 4);
+    SDL_Vertex* quads = batch.vertices.data() + first;
+    pool.parallelFor(swarm.count, ALIEN_GRAIN, [&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            int s = alienSizeIndex(swarm.size[i]);
+            const SDL_Rect& cell = sprites.cells[(size_t)s * ALIEN_WIGGLE_FRAMES + alienWiggleFrame(swarm.phase[i], t)];
+            const SDL_Point& center = sprites.centers[s];
+            SDL_FRect dst;
+            if (swarm.size[i] >= ALIEN_MIN_SIZE) {
+                dst = {(float)((int)swarm.x[i] - center.x), (float)((int)swarm.y[i] - center.y), (float)cell.w,
+                       (float)cell.h};
+            } else {
+                float scale = swarm.size[i] / ALIEN_MIN_SIZE;
+                dst = {swarm.x[i] - center.x * scale, swarm.y[i] - center.y * scale, cell.w * scale, cell.h * scale};
+            }
+            SDL_FRect uv = {(float)cell.x / sprites.width, (float)cell.y / sprites.height,
+                            (float)cell.w / sprites.width, (float)cell.h / sprites.height};
+            setQuad(quads + (size_t)i * 4, dst, uv, {255, 255, 255, 255});
+        }
+    });
+}
+
+// Heads shrink when the aliens would cover more than ALIEN_COVERAGE of the
+// screen. They start on a ring while they fit on it, otherwise scattered.
+void initAliens(AlienSwarm& swarm, int count, int width, int height, Uint64 seed) {
+    swarm.count = count;
+    swarm.width = width;
+    swarm.height = height;
+    for (std::vector<float>* v : {&swarm.x, &swarm.y, &swarm.vx, &swarm.vy, &swarm.size, &swarm.phase,
+                                  &swarm.nextX, &swarm.nextY, &swarm.nextVx, &swarm.nextVy}) {
+        v->resize(count);
+    }
+    swarm.cell.resize(count);
+    swarm.cellItems.resize(count);
+    float average = 0.5f * (ALIEN_MIN_SIZE + ALIEN_MAX_SIZE);
+    float scale = sqrtf(ALIEN_COVERAGE * width * height / (count * (float)M_PI * average * average));
+    if (scale > 1) scale = 1;
+    float ringX = width * 0.3f;
+    float ringY = height * 0.18f;
+    float perimeter = 2 * (float)M_PI * sqrtf(0.5f * (ringX * ringX + ringY * ringY));
+    bool ring = perimeter / count >= 2 * ALIEN_MAX_SIZE * scale;
+    Rng rng(deriveSeed(seed, "aliens"));
+    for (int i = 0; i < count; ++i) {
+        float size = (32.0f + 16.0f * rng.below(100) / 100.0f) * scale;
+        if (size < 1) size = 1;
+        swarm.size[i] = size;
+        swarm.phase[i] = (float)rng.below(1000) / 100.0f;
         // Plate velocity: random direction and speed
-        float plateAngle = (float)(rand() % 628) / 100.0f; // 0..2pi
-        float plateSpeed = 1.5f + 1.5f * (rand() % 100) / 100.0f;
-        aliens[i].vx = cosf(plateAngle) * plateSpeed;
-        aliens[i].vy = sinf(plateAngle) * plateSpeed;
+        float plateAngle = (float)rng.below(628) / 100.0f; // 0..2pi
+        float plateSpeed = 1.5f + 1.5f * rng.below(100) / 100.0f;
+        swarm.vx[i] = cosf(plateAngle) * plateSpeed;
+        swarm.vy[i] = sinf(plateAngle) * plateSpeed;
+        if (ring) {
+            float angle = (2 * M_PI * i) / count;
+            swarm.x[i] = width / 2 + cosf(angle) * ringX;
+            swarm.y[i] = height / 2 + sinf(angle) * ringY;
+        } else {
+            swarm.x[i] = size + rng.uniform() * (width - 2 * size);
+            swarm.y[i] = size + rng.uniform() * (height - 2 * size);
+        }
+    }
+    // Cells at least as wide as the largest head, but no more than about four per alien
+    // so clearing and summing the grid stays cheap next to the aliens
+    float largest = 1;
+    for (float size : swarm.size) {
+        if (size > largest) largest = size;
     }
+    float sparse = sqrtf((float)width * height / (4.0f * count));
+    swarm.cellSize = 2 * largest > sparse ? 2 * largest : sparse;
+    swarm.cols = (int)(width / swarm.cellSize) + 1;
+    swarm.rows = (int)(height / swarm.cellSize) + 1;
+    swarm.cellStart.assign((size_t)swarm.cols * swarm.rows + 1, 0);
+}
 
-    bool quit = false;
-    SDL_Event e;
-    int t = 0;
-    float speed = 28.0f;
-    int plasmaStep = 2;
-    while (!quit) {
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) {
-                quit = true;
-            }
+// Straight lines, turning back at the screen edges
+void moveAliens(AlienSwarm& swarm, float step, ThreadPool& pool) {
+    pool.parallelFor(swarm.count, ALIEN_GRAIN, [&](int i0, int i1) {
+        float* x = swarm.x.data();
+        float* y = swarm.y.data();
+        float* vx = swarm.vx.data();
+        float* vy = swarm.vy.data();
+        const float* size = swarm.size.data();
+        for (int i = i0; i < i1; ++i) {
+            x[i] += vx[i] * step;
+            y[i] += vy[i] * step;
+            if ((x[i] < size[i] && vx[i] < 0) || (x[i] > swarm.width - size[i] && vx[i] > 0)) vx[i] = -vx[i];
+            if ((y[i] < size[i] && vy[i] < 0) || (y[i] > swarm.height - size[i] && vy[i] > 0)) vy[i] = -vy[i];
         }
-        // Draw faint plasma background (skip pixels for speed)
-        void* pixels;
-        int pitch;
-        SDL_LockTexture(texture, NULL, &pixels, &pitch);
-        Uint32* buf = (Uint32*)pixels;
-        for (int y = 0; y < screenHeight; y += plasmaStep) {
-            for (int x = 0; x < screenWidth; x += plasmaStep) {
-                Uint32 color = plasmaColor(x, y, t);
-                for (int dy = 0; dy < plasmaStep && y + dy < screenHeight; ++dy) {
-                    for (int dx = 0; dx < plasmaStep && x + dx < screenWidth; ++dx) {
-                        buf[(y + dy) * (pitch / 4) + (x + dx)] = color;
+    });
+}
+
+// Overlapping heads are pushed apart along the line between their centers, half
+// the overlap each, and while they approach they swap their velocities along
+// that line like equal masses in an elastic collision. The aliens are binned
+// into the grid by a counting sort, then each one checks the 3x3 cells around
+// its own and writes only its own next state.
+void collideAliens(AlienSwarm& swarm, ThreadPool& pool) {
+    const int cols = swarm.cols;
+    const int rows = swarm.rows;
+    const float inverseCell = 1.0f / swarm.cellSize;
+    pool.parallelFor(swarm.count, ALIEN_GRAIN, [&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            int cx = (int)(swarm.x[i] * inverseCell);
+            int cy = (int)(swarm.y[i] * inverseCell);
+            cx = cx < 0 ? 0 : cx >= cols ? cols - 1 : cx;
+            cy = cy < 0 ? 0 : cy >= rows ? rows - 1 : cy;
+            swarm.cell[i] = cy * cols + cx;
+        }
+    });
+    // In alien order, so every alien meets its neighbours in the same order each run
+    std::vector<int>& start = swarm.cellStart;
+    int cells = cols * rows;
+    std::fill(start.begin(), start.end(), 0);
+    for (int i = 0; i < swarm.count; ++i) {
+        ++start[swarm.cell[i] + 1];
+    }
+    for (int c = 0; c < cells; ++c) {
+        start[c + 1] += start[c];
+    }
+    for (int i = 0; i < swarm.count; ++i) {
+        swarm.cellItems[start[swarm.cell[i]]++] = i;
+    }
+    for (int c = cells; c > 0; --c) {
+        start[c] = start[c - 1];
+    }
+    start[0] = 0;
+    pool.parallelFor(swarm.count, ALIEN_GRAIN, [&](int i0, int i1) {
+        const float* x = swarm.x.data();
+        const float* y = swarm.y.data();
+        const float* vx = swarm.vx.data();
+        const float* vy = swarm.vy.data();
+        const float* size = swarm.size.data();
+        for (int i = i0; i < i1; ++i) {
+            float pushX = 0, pushY = 0, dvx = 0, dvy = 0;
+            int cx = swarm.cell[i] % cols;
+            int cy = swarm.cell[i] / cols;
+            for (int gy = cy > 0 ? cy - 1 : 0; gy <= cy + 1 && gy < rows; ++gy) {
+                for (int gx = cx > 0 ? cx - 1 : 0; gx <= cx + 1 && gx < cols; ++gx) {
+                    int c = gy * cols + gx;
+                    for (int k = start[c]; k < start[c + 1]; ++k) {
+                        int j = swarm.cellItems[k];
+                        float ox = x[j] - x[i];
+                        float oy = y[j] - y[i];
+                        float reach = size[i] + size[j];
+                        float d2 = ox * ox + oy * oy;
+                        if (j == i || d2 >= reach * reach) continue;
+                        float d = sqrtf(d2);
+                        float nx = 1.0f, ny = 0.0f;
+                        if (d > 1e-3f) {
+                            nx = ox / d;
+                            ny = oy / d;
+                        } else if (j < i) {
+                            nx = -1.0f; // same spot: split them along x
+                        }
+                        float overlap = reach - d;
+                        pushX -= nx * overlap * 0.5f;
+                        pushY -= ny * overlap * 0.5f;
+                        float closing = (vx[i] - vx[j]) * nx + (vy[i] - vy[j]) * ny;
+                        if (closing > 0) {
+                            dvx -= closing * nx;
+                            dvy -= closing * ny;
+                        }
                     }
                 }
             }
+            // Pushes never move an alien through a screen edge
+            swarm.nextX[i] = fminf(fmaxf(x[i] + pushX, size[i]), swarm.width - size[i]);
+            swarm.nextY[i] = fminf(fmaxf(y[i] + pushY, size[i]), swarm.height - size[i]);
+            // Collisions only turn an alien: with several contacts at once the
+            // summed swaps would otherwise speed up or stall a crowd
+            float nextVx = vx[i] + dvx;
+            float nextVy = vy[i] + dvy;
+            float before = vx[i] * vx[i] + vy[i] * vy[i];
+            float after = nextVx * nextVx + nextVy * nextVy;
+            float keep = after > 1e-6f ? sqrtf(before / after) : 0.0f;
+            swarm.nextVx[i] = keep > 0 ? nextVx * keep : -vx[i];
+            swarm.nextVy[i] = keep > 0 ? nextVy * keep : -vy[i];
+        }
+    });
+    swarm.x.swap(swarm.nextX);
+    swarm.y.swap(swarm.nextY);
+    swarm.vx.swap(swarm.nextVx);
+    swarm.vy.swap(swarm.nextVy);
+}
+
+struct AliensEffect : Effect {
+    GalaxyBackground background{"alliens", GALAXY_BACKGROUND};
+    StarOptions starOptions;
+    AlienOptions alienOptions;
+    Starfield stars;
+    AlienSwarm aliens;
+    Uint64 simulationTicks = 0;  // alien movement and collisions, reported per 10k aliens
+    Uint64 simulationFrames = 0;
+    AlienSprites sprites;
+    QuadBatch alienBatch;
+    SpanBatch spans;  // --alien-engine points
+    float speed = 28.0f;
+
+    const char* name() const override { return "alliens"; }
+
+    bool init(EffectContext& ctx) override {
+        const KioskOptions& options = ctx.options;
+        starOptions.count = NUM_STARS;
+        if (!parseStarOptions(ctx.argc, ctx.argv, starOptions) ||
+            !parseAlienOptions(ctx.argc, ctx.argv, alienOptions) ||
+            !background.init(ctx)) {
+            return false;
+        }
+        int width = ctx.kiosk.width;
+        int height = ctx.kiosk.height;
+        initStarfield(stars, starOptions.count, width, height, {180.0f, 75.0f}, options.seed); // brighter stars
+        initAliens(aliens, alienOptions.count, width, height, options.seed);
+        ctx.bench.addField("stars", std::to_string(starOptions.count));
+        ctx.bench.addField("aliens", std::to_string(alienOptions.count));
+        ctx.bench.addField("alien_engine", alienOptions.sprites ? "sprites" : "points");
+        ctx.bench.addField("alien_collisions", alienOptions.collisions ? "on" : "off");
+        ctx.bench.addField("star_mode", !starOptions.splat ? "renderer" : starOptions.additive ? "splat-additive" : "splat");
+        // Splat mode: stars are plotted into the background texture by the workers that shade it
+        if (starOptions.splat) {
+            setStarfieldBands(stars, background.divisor());
+        }
+        return true;
+    }
+
+    bool resize(EffectContext& ctx) override {
+        if (alienOptions.sprites && !sprites.texture && !buildAlienSprites(ctx.kiosk.renderer, sprites)) {
+            return false;
+        }
+        return background.resize(ctx);
+    }
+
+    void update(EffectContext& ctx) override {
+        float step = ctx.scheduler.step();
+        TraceScope scope(ctx.trace, STAGE_COMPUTE);
+        updateStarfield(stars, speed * step, ctx.pool);
+        Uint64 start = SDL_GetPerformanceCounter();
+        moveAliens(aliens, step, ctx.pool);
+        if (alienOptions.collisions) {
+            collideAliens(aliens, ctx.pool);
+        }
+        simulationTicks += SDL_GetPerformanceCounter() - start;
+        ++simulationFrames;
+    }
+
+    void render(EffectContext& ctx) override {
+        SDL_Renderer* renderer = ctx.kiosk.renderer;
+        GalaxyBackground::Overlay splat;
+        if (starOptions.splat) {
+            splat = [this](int row0, int row1, Uint32* pixels, int pitchPixels) {
+                splatStarRows(stars, row0, row1, pixels, pitchPixels, starOptions.additive);
+            };
         }
-        SDL_UnlockTexture(texture);
-        SDL_RenderClear(renderer);
-        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        // Draw faint plasma background at reduced resolution
+        background.render(ctx, splat);
+        TraceScope scope(ctx.trace, STAGE_DRAW);
         // Draw stars on top
-        for (int i = 0; i < NUM_STARS; ++i) {
-            Star& s = stars[i];
-            s.z -= speed;
-            if (s.z <= 1) {
-                initStar(s, screenWidth, screenHeight);
-                s.z = (float)screenWidth;
-            }
-            int sx = (int)((s.x / s.z) * (screenWidth / 2) + screenWidth / 2);
-            int sy = (int)((s.y / s.z) * (screenHeight / 2) + screenHeight / 2);
-            if (sx < 0 || sx >= screenWidth || sy < 0 || sy >= screenHeight) {
-                initStar(s, screenWidth, screenHeight);
-                s.z = (float)screenWidth;
-                continue;
+        if (!starOptions.splat) {
+            drawStarfield(renderer, stars);
+        }
+        float t = wrapAnimationTime(ctx.scheduler.frameTime(), ALIEN_WIGGLE_PERIOD);
+        if (alienOptions.sprites) {
+            addAlienSprites(alienBatch, sprites, aliens, t, ctx.pool);
+            drawQuadBatch(renderer, sprites.texture, alienBatch);
+        } else {
+            for (int i = 0; i < aliens.count; ++i) {
+                drawAlien(renderer, spans, aliens.x[i], aliens.y[i], aliens.size[i], aliens.phase[i], t);
             }
-            float brightness = 1.0f - (s.z / screenWidth);
-            if (brightness < 0) brightness = 0;
-            if (brightness > 1) brightness = 1;
-            Uint8 color = (Uint8)(180 + brightness * 75);
-            SDL_SetRenderDrawColor(renderer, color, color, color, 255);
-            SDL_RenderDrawPoint(renderer, sx, sy);
-        }
-        // Animate and draw aliens
-        for (int i = 0; i < NUM_ALIENS; ++i) {
-            // Plate movement: move in a straight line, bounce off edges
-            aliens[i].x += aliens[i].vx;
-            aliens[i].y += aliens[i].vy;
-            if (aliens[i].x < aliens[i].size || aliens[i].x > screenWidth - aliens[i].size) aliens[i].vx = -aliens[i].vx;
-            if (aliens[i].y < aliens[i].size || aliens[i].y > screenHeight - aliens[i].size) aliens[i].vy = -aliens[i].vy;
-            drawAlien(renderer, aliens[i].x, aliens[i].y, aliens[i].size, aliens[i].phase, t);
-        }
-        SDL_RenderPresent(renderer);
-        SDL_Delay(10);
-        ++t;
-    }
-    SDL_DestroyTexture(texture);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
-    return 0;
+        }
+    }
+
+    bool endFrame(EffectContext& ctx) override {
+        if (!background.endFrame(ctx)) {
+            return false;
+        }
+        if (starOptions.splat && stars.bandDivisor != background.divisor()) {
+            setStarfieldBands(stars, background.divisor());
+        }
+        return true;
+    }
+
+    void report(EffectContext& ctx) override {
+        background.report(ctx);
+        if (simulationFrames > 0) {
+            double usPerFrame = simulationTicks * 1e6 / SDL_GetPerformanceFrequency() / simulationFrames;
+            SDL_Log("Alien simulation: %.2f us per 10k aliens (%d aliens, collisions %s)",
+                    usPerFrame * 10000.0 / aliens.count, aliens.count, alienOptions.collisions ? "on" : "off");
+        }
+    }
+
+    // The background at the default 1/2 resolution; aliens and stars are drawn by the renderer
+    void verify(VerifyRun& run) override {
+        background.verify(run);
+        verifyAnimationClock(run, "alliens", "clock/wiggle", ALIEN_WIGGLE_PERIOD);
+    }
+
+    void release(EffectContext&) override {
+        background.release();
+        if (sprites.texture) SDL_DestroyTexture(sprites.texture);
+        sprites.texture = nullptr;
+    }
+};
+
+} // namespace alliens
+
+#ifndef KIOSK_HOST
+int main(int argc, char* argv[]) {
+    alliens::AliensEffect effect;
+    return runEffect(effect, "Aliens in the Galaxy", argc, argv);
 }
+#endif
@@ -0,0 +1,178 @@
+// anim_cache.h
+// One period of a looping background rendered once into a file, memory-mapped and streamed back frame by frame
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "indexed.h"
+
+// Bump whenever the file layout changes; the shading code has its own revision in params
+const Uint32 ANIM_CACHE_VERSION = 1;
+const char ANIM_CACHE_MAGIC[8] = {'P', 'L', 'A', 'S', 'M', 'A', 'A', 'C'};
+const Uint64 ANIM_CACHE_ALIGN = 4096;  // frames start on a page boundary
+
+enum AnimCacheFormat : Uint32 {
+    ANIM_CACHE_RGB = 0,      // RGB888 pixels, copied into the texture as is
+    ANIM_CACHE_INDEXED = 1,  // 8-bit indices, expanded through the palette stored after the header
+};
+
+struct AnimCacheHeader {
+    char magic[8];
+    Uint32 version;
+    Uint32 headerBytes;
+    char content[32];   // what the frames show, e.g. "galaxy", not which effect plays them
+    Uint32 width;       // frame size in pixels (texture size, not screen size)
+    Uint32 height;
+    Uint32 format;
+    Uint32 frames;      // evenly spaced over one period of the animation
+    Uint64 params;      // hash of everything else the frames depend on
+    Uint64 frameBytes;
+    Uint64 dataOffset;
+};
+
+struct AnimCache {
+    AnimCacheHeader header = {};
+    void* map = nullptr;
+    size_t mapBytes = 0;
+    const Uint32* palette = nullptr;  // indexed format only
+    const Uint8* data = nullptr;
+};
+
+// --anim-cache PATH: play the background from PATH, rendering it first if missing or stale
+inline bool parseAnimCachePath(int argc, char* argv[], std::string& path) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--anim-cache") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        }
+    }
+    return true;
+}
+
+// FNV-1a over the parameters a cache depends on; chain calls to hash several values
+inline Uint64 animCacheHash(const void* bytes, size_t count, Uint64 hash = 0xCBF29CE484222325ull) {
+    const Uint8* p = (const Uint8*)bytes;
+    for (size_t i = 0; i < count; ++i) {
+        hash = (hash ^ p[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+inline AnimCacheHeader makeAnimCacheHeader(const char* content, int width, int height, AnimCacheFormat format,
+                                           int frames, Uint64 params) {
+    AnimCacheHeader header = {};
+    memcpy(header.magic, ANIM_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ANIM_CACHE_VERSION;
+    header.headerBytes = sizeof(AnimCacheHeader);
+    strncpy(header.content, content, sizeof(header.content) - 1);
+    header.width = width;
+    header.height = height;
+    header.format = format;
+    header.frames = frames;
+    header.params = params;
+    header.frameBytes = (Uint64)width * height * (format == ANIM_CACHE_INDEXED ? 1 : 4);
+    Uint64 paletteBytes = format == ANIM_CACHE_INDEXED ? INDEXED_COLORS * sizeof(Uint32) : 0;
+    Uint64 prefixBytes = sizeof(AnimCacheHeader) + paletteBytes;
+    header.dataOffset = (prefixBytes + ANIM_CACHE_ALIGN - 1) / ANIM_CACHE_ALIGN * ANIM_CACHE_ALIGN;
+    return header;
+}
+
+inline void closeAnimCache(AnimCache& cache) {
+    if (cache.map) munmap(cache.map, cache.mapBytes);
+    cache.map = nullptr;
+    cache.palette = nullptr;
+    cache.data = nullptr;
+}
+
+// Map an existing cache; fails quietly with a logged reason when it is missing,
+// truncated or was written for another version, content, size or parameters
+inline bool openAnimCache(const std::string& path, const AnimCacheHeader& expected, AnimCache& cache) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        SDL_Log("Animation cache %s not found, rendering it", path.c_str());
+        return false;
+    }
+    struct stat info;
+    Uint64 bytes = expected.dataOffset + expected.frameBytes * expected.frames;
+    if (fstat(fd, &info) != 0 || (Uint64)info.st_size != bytes) {
+        SDL_Log("Animation cache %s has the wrong size, rebuilding", path.c_str());
+        close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        SDL_Log("Animation cache %s could not be mapped", path.c_str());
+        return false;
+    }
+    if (memcmp(map, &expected, sizeof(AnimCacheHeader)) != 0) {
+        SDL_Log("Animation cache %s is stale, rebuilding", path.c_str());
+        munmap(map, bytes);
+        return false;
+    }
+    cache.header = expected;
+    cache.map = map;
+    cache.mapBytes = bytes;
+    if (expected.format == ANIM_CACHE_INDEXED) {
+        cache.palette = (const Uint32*)((const Uint8*)map + sizeof(AnimCacheHeader));
+    }
+    cache.data = (const Uint8*)map + expected.dataOffset;
+    return true;
+}
+
+// Render every frame with renderFrame(index, out) and write the file under a
+// temporary name first, so an interrupted build never leaves a valid-looking cache
+inline bool writeAnimCache(const std::string& path, const AnimCacheHeader& header, const Uint32* palette,
+                           const std::function<void(int, Uint8*)>& renderFrame) {
+    std::string partial = path + ".partial";
+    FILE* file = fopen(partial.c_str(), "wb");
+    if (!file) {
+        SDL_Log("Animation cache %s could not be written", partial.c_str());
+        return false;
+    }
+    std::vector<Uint8> prefix(header.dataOffset, 0);
+    memcpy(prefix.data(), &header, sizeof(AnimCacheHeader));
+    if (header.format == ANIM_CACHE_INDEXED) {
+        memcpy(prefix.data() + sizeof(AnimCacheHeader), palette, INDEXED_COLORS * sizeof(Uint32));
+    }
+    bool ok = fwrite(prefix.data(), 1, prefix.size(), file) == prefix.size();
+    std::vector<Uint8> frame(header.frameBytes);
+    for (Uint32 i = 0; ok && i < header.frames; ++i) {
+        renderFrame((int)i, frame.data());
+        ok = fwrite(frame.data(), 1, frame.size(), file) == frame.size();
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(partial.c_str(), path.c_str()) != 0) {
+        SDL_Log("Animation cache %s could not be written", path.c_str());
+        remove(partial.c_str());
+        return false;
+    }
+    SDL_Log("Animation cache %s: %u frames of %ux%u, %.1f MiB", path.c_str(), header.frames, header.width,
+            header.height, (header.dataOffset + header.frameBytes * header.frames) / 1048576.0);
+    return true;
+}
+
+inline const Uint8* animCacheFrame(const AnimCache& cache, int index) {
+    return cache.data + (size_t)index * cache.header.frameBytes;
+}
+
+// Copy or expand rows [row0, row1) of one cached frame into an RGB888 buffer
+inline void streamAnimCacheRows(const AnimCache& cache, SimdLevel level, int index, int row0, int row1,
+                                Uint32* pixels, int pitchPixels) {
+    const Uint8* frame = animCacheFrame(cache, index);
+    int width = (int)cache.header.width;
+    for (int row = row0; row < row1; ++row) {
+        Uint32* out = pixels + (size_t)row * pitchPixels;
+        if (cache.header.format == ANIM_CACHE_INDEXED) {
+            expandIndexedRow(level, frame + (size_t)row * width, cache.palette, width, out);
+        } else {
+            memcpy(out, frame + (size_t)row * width * 4, (size_t)width * 4);
+        }
+    }
+}
@@ -0,0 +1,159 @@
+// effect.h
+// Effect interface and the frame loop that drives one: the runtime owns the window, renderer,
+// worker pool, clock and trace, and an effect only builds its state and draws frames
+#pragma once
+#include <SDL2/SDL.h>
+#include "frame_export.h"
+#include "frame_scheduler.h"
+#include "frame_trace.h"
+#include "kiosk.h"
+#include "thread_pool.h"
+#include "verify.h"
+
+// What the runtime lends an effect for one call. argc/argv still hold the
+// effect-specific options; pool and bench may differ between calls (init
+// runs on a private pool in the host, and every effect reports on its own bench).
+struct EffectContext {
+    int argc;
+    char** argv;
+    const KioskOptions& options;
+    Kiosk& kiosk;
+    ThreadPool& pool;
+    FrameScheduler& scheduler;
+    FrameTrace& trace;
+    FrameBench& bench;
+    FrameExport& exporter;
+};
+
+struct Effect {
+    virtual ~Effect() {}
+    virtual const char* name() const = 0;
+    // Parse the effect's options and build its CPU-side tables and caches for the
+    // kiosk size. The host runs this on a background thread, so no renderer calls.
+    virtual bool init(EffectContext& ctx) = 0;
+    // Create (or recreate) the renderer resources for the kiosk size; main thread
+    virtual bool resize(EffectContext& ctx) = 0;
+    // The effect is about to be shown, for the first time or again
+    virtual void show(EffectContext& ctx) { (void)ctx; }
+    // Events other than the quit key, e.g. SDL_RENDER_TARGETS_RESET
+    virtual void event(EffectContext& ctx, const SDL_Event& e) { (void)ctx; (void)e; }
+    // Advance the simulation by ctx.scheduler.step()
+    virtual void update(EffectContext& ctx) { (void)ctx; }
+    // Shade and draw the frame; the runtime presents it
+    virtual void render(EffectContext& ctx) = 0;
+    // After the frame is presented, before the scheduler sleeps; false stops the run
+    virtual bool endFrame(EffectContext& ctx) { (void)ctx; return true; }
+    // Log effect statistics on exit; runs before the bench report, so it can still add fields
+    virtual void report(EffectContext& ctx) { (void)ctx; }
+    // Free what resize() created
+    virtual void release(EffectContext& ctx) = 0;
+    // --verify: check the fast kernels against the reference formula; no window exists
+    virtual void verify(VerifyRun& run) { (void)run; }
+};
+
+// --verify: step the fixed-step clock 72 hours into a run and check that every
+// frame still advances the animation by one 60 Hz frame after the time is
+// narrowed for the kernels, which wrap it to `period` frames
+inline void verifyAnimationClock(VerifyRun& run, const char* effect, const char* name, double period) {
+    KioskOptions options;
+    options.bench = true;
+    Kiosk kiosk;
+    FrameScheduler scheduler(options, kiosk);
+    scheduler.frames = (Uint64)(72 * 3600 * scheduler.hz);
+    double maxError = 0;
+    float previous = 0;
+    for (int i = 0; i <= 600; ++i) {
+        scheduler.beginFrame();
+        float t = wrapAnimationTime(scheduler.frameTime(), period);
+        if (i > 0) {
+            double delta = (double)t - previous;
+            if (delta < 0) delta += period;
+            if (fabs(delta - 1.0) > maxError) maxError = fabs(delta - 1.0);
+        }
+        previous = t;
+        scheduler.endFrame();
+    }
+    run.check(effect, "72h", name, maxError < 1e-3);
+}
+
+// One frame of the current effect. Returns false when the user quits or a bench run is complete.
+inline bool runEffectFrame(Effect& effect, EffectContext& ctx, bool& switchRequested) {
+    bool keepRunning = true;
+    ctx.bench.beginFrame();
+    ctx.trace.beginFrame();
+    ctx.scheduler.beginFrame();
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) {
+            keepRunning = false;
+        } else if (e.type == SDL_KEYDOWN && (e.key.keysym.sym == SDLK_SPACE || e.key.keysym.sym == SDLK_RIGHT)) {
+            switchRequested = true;
+        } else {
+            effect.event(ctx, e);
+        }
+    }
+    effect.update(ctx);
+    effect.render(ctx);
+    // Read back before presenting; the back buffer is undefined afterwards
+    if (ctx.exporter.enabled()) {
+        TraceScope scope(ctx.trace, STAGE_EXPORT);
+        if (!ctx.exporter.capture(ctx.kiosk.renderer)) {
+            keepRunning = false;
+        }
+    }
+    {
+        TraceScope scope(ctx.trace, STAGE_PRESENT);
+        SDL_RenderPresent(ctx.kiosk.renderer);
+    }
+    ctx.trace.endFrame();
+    if (ctx.bench.endFrame()) {
+        keepRunning = false;
+    }
+    if (!effect.endFrame(ctx)) {
+        keepRunning = false;
+    }
+    ctx.scheduler.endFrame();
+    return keepRunning;
+}
+
+// main() of a standalone effect: open the kiosk, run the effect until ESC
+// (or --frames in bench mode) and report
+inline int runEffect(Effect& effect, const char* title, int argc, char* argv[]) {
+    KioskOptions options;
+    if (!parseKioskOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.verify) {
+        VerifyRun run(options);
+        effect.verify(run);
+        return run.finish() ? 0 : 1;
+    }
+    Kiosk kiosk;
+    if (!openKiosk(title, options, kiosk)) {
+        return 1;
+    }
+    ThreadPool pool(options.threads);
+    SDL_Log("Rendering on %d thread(s)", pool.threadCount());
+    FrameBench bench(options);
+    FrameTrace trace(options.tracePath, options.budgetMs);
+    FrameScheduler scheduler(options, kiosk);
+    FrameExport exporter;
+    EffectContext ctx = {argc, argv, options, kiosk, pool, scheduler, trace, bench, exporter};
+    if (!effect.init(ctx) || !effect.resize(ctx) || !exporter.open(options, kiosk.width, kiosk.height, scheduler.hz)) {
+        effect.release(ctx);
+        closeKiosk(kiosk);
+        return 1;
+    }
+    scheduler.restart();
+    effect.show(ctx);
+    bool switchRequested = false;
+    while (runEffectFrame(effect, ctx, switchRequested)) {
+    }
+    bool exported = exporter.close();
+    effect.report(ctx);
+    bench.report(effect.name(), kiosk, options);
+    scheduler.report();
+    effect.release(ctx);
+    closeKiosk(kiosk);
+    return exported ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// fixed_point.h
+// Integer-only trigonometry for the fixed-point engines, for CPUs whose floating point is slow or emulated
+#pragma once
+#include <SDL2/SDL.h>
+#include <cmath>
+
+// Angles are Uint32 fractions of a turn: 2^32 is one full turn, so adding
+// phases wraps for free and never loses precision as time grows.
+const double FIX_TURN = 4294967296.0;
+const double FIX_RADIAN = FIX_TURN / 6.283185307179586;  // angle units per radian
+
+const int FIX_SIN_BITS = 10;               // 1024 table entries per turn
+const int FIX_SIN_ONE = 1 << 14;           // sine results are Q14
+const int FIX_ATAN_BITS = 8;               // 256 entries over tan in [0, 1]
+
+// Built once at startup; linear interpolation between entries keeps the
+// sine within 1 Q14 step of sin() and atan within 2^-20 of a turn.
+struct FixedTables {
+    Sint16 sine[(1 << FIX_SIN_BITS) + 1];
+    Uint32 atan[(1 << FIX_ATAN_BITS) + 1];  // atan(i / 256) as an angle
+
+    FixedTables() {
+        for (int i = 0; i <= (1 << FIX_SIN_BITS); ++i) {
+            sine[i] = (Sint16)lround(FIX_SIN_ONE * sin(6.283185307179586 * i / (1 << FIX_SIN_BITS)));
+        }
+        for (int i = 0; i <= (1 << FIX_ATAN_BITS); ++i) {
+            atan[i] = (Uint32)llround(::atan((double)i / (1 << FIX_ATAN_BITS)) * FIX_RADIAN);
+        }
+    }
+};
+
+inline const FixedTables& fixedTables() {
+    static const FixedTables tables;
+    return tables;
+}
+
+// Q14 sine of an angle
+inline int fixSin(Uint32 angle) {
+    const Sint16* sine = fixedTables().sine;
+    Uint32 i = angle >> (32 - FIX_SIN_BITS);
+    int frac = (int)((angle >> (32 - FIX_SIN_BITS - 16)) & 0xFFFF);
+    return sine[i] + (((sine[i + 1] - sine[i]) * frac) >> 16);
+}
+
+// round(scale * sin(angle)), e.g. the plasma's 128 * sin terms
+inline int fixSinScaled(Uint32 angle, int scale) {
+    return (fixSin(angle) * scale + (FIX_SIN_ONE >> 1)) >> 14;
+}
+
+// floor(sqrt(v))
+inline Uint32 isqrt64(Uint64 v) {
+    Uint64 root = 0;
+    Uint64 bit = (Uint64)1 << 62;
+    while (bit > v) bit >>= 2;
+    while (bit != 0) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (Uint32)root;
+}
+
+// atan2(y, x) as an angle, reduced to one octant and read from the table
+inline Uint32 fixAtan2(Sint64 y, Sint64 x) {
+    if (x == 0 && y == 0) return 0;
+    Uint64 ax = x < 0 ? -x : x;
+    Uint64 ay = y < 0 ? -y : y;
+    bool steep = ay > ax;
+    Uint64 lo = steep ? ax : ay;
+    Uint64 hi = steep ? ay : ax;
+    // tan in Q16 of the angle within the octant
+    Uint32 ratio = (Uint32)((lo << 16) / hi);
+    Uint32 i = ratio >> (16 - FIX_ATAN_BITS);
+    Uint32 frac = ratio & ((1 << (16 - FIX_ATAN_BITS)) - 1);
+    const Uint32* table = fixedTables().atan;
+    Uint32 angle = table[i];
+    if (i < (1 << FIX_ATAN_BITS)) {
+        angle += (Uint32)(((Uint64)(table[i + 1] - table[i]) * frac) >> (16 - FIX_ATAN_BITS));
+    }
+    const Uint32 quarter = 1u << 30;
+    if (steep) angle = quarter - angle;
+    if (x < 0) angle = 2 * quarter - angle;
+    if (y < 0) angle = 0u - angle;
+    return angle;
+}
+
+// Convert a time-based phase once per frame: fmod keeps the double exact
+// for long runs before it is truncated to an angle
+inline Uint32 fixAngleOf(double radians) {
+    double turns = radians / 6.283185307179586;
+    turns -= floor(turns);
+    return (Uint32)(Uint64)(turns * FIX_TURN);
+}
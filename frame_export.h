@@ -0,0 +1,382 @@
+// frame_export.h
+// Offline frame export: every rendered frame is read back and written as raw RGB,
+// a Y4M stream or a PNG sequence, with conversion and writing on their own threads
+#pragma once
+#include <SDL2/SDL.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "kiosk.h"
+#include "thread_pool.h"
+
+const int EXPORT_SLOTS = 4; // frames in flight between capture, conversion and writing
+
+// Raw and Y4M go to one stream (a file or stdout with "-"); PNG writes
+// PATH_00000.png, PATH_00001.png, ... next to the given name
+inline std::string exportFramePath(const std::string& path, Uint64 index) {
+    std::string stem = path;
+    if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".png") == 0) {
+        stem.resize(stem.size() - 4);
+    }
+    char number[32];
+    snprintf(number, sizeof(number), "_%05llu.png", (unsigned long long)index);
+    return stem + number;
+}
+
+// RGB888 row to packed RGB24, the layout ffmpeg calls rgb24
+inline void exportRgbRow(const Uint32* in, int width, Uint8* out) {
+    for (int x = 0; x < width; ++x) {
+        out[3 * x] = (Uint8)(in[x] >> 16);
+        out[3 * x + 1] = (Uint8)(in[x] >> 8);
+        out[3 * x + 2] = (Uint8)in[x];
+    }
+}
+
+// BT.601 studio range in 8-bit integer math, luma per pixel
+inline Uint8 exportLuma(Uint32 c) {
+    int r = (c >> 16) & 0xFF, g = (c >> 8) & 0xFF, b = c & 0xFF;
+    return (Uint8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+// Luma rows 2*cy and 2*cy+1 and chroma row cy of a 4:2:0 frame; chroma is
+// converted from the 2x2 average, and odd edges repeat the last pixel
+inline void exportYuvRows(const Uint32* pixels, int width, int height, int cy, Uint8* yPlane, Uint8* uPlane,
+                          Uint8* vPlane) {
+    int chromaWidth = (width + 1) / 2;
+    const Uint32* row0 = pixels + (size_t)(2 * cy) * width;
+    const Uint32* row1 = 2 * cy + 1 < height ? row0 + width : row0;
+    Uint8* y0 = yPlane + (size_t)(2 * cy) * width;
+    for (int x = 0; x < width; ++x) {
+        y0[x] = exportLuma(row0[x]);
+    }
+    if (row1 != row0) {
+        Uint8* y1 = y0 + width;
+        for (int x = 0; x < width; ++x) {
+            y1[x] = exportLuma(row1[x]);
+        }
+    }
+    Uint8* u = uPlane + (size_t)cy * chromaWidth;
+    Uint8* v = vPlane + (size_t)cy * chromaWidth;
+    for (int cx = 0; cx < chromaWidth; ++cx) {
+        int x0 = 2 * cx;
+        int x1 = x0 + 1 < width ? x0 + 1 : x0;
+        Uint32 p[4] = {row0[x0], row0[x1], row1[x0], row1[x1]};
+        int r = 0, g = 0, b = 0;
+        for (Uint32 c : p) {
+            r += (c >> 16) & 0xFF;
+            g += (c >> 8) & 0xFF;
+            b += c & 0xFF;
+        }
+        // Sums are 4x the average, so the usual >> 8 becomes >> 10
+        u[cx] = (Uint8)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+        v[cx] = (Uint8)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+    }
+}
+
+// PNG without zlib: the image data goes into stored (uncompressed) deflate
+// blocks, so encoding is a copy plus checksums. Files are about the size of
+// the raw frame; recompress them offline if size matters.
+struct PngChecksums {
+    Uint32 crc[8][256]; // slicing-by-8 tables: crc[k][n] is n's CRC shifted through k more zero bytes
+
+    PngChecksums() {
+        for (Uint32 n = 0; n < 256; ++n) {
+            Uint32 c = n;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc[0][n] = c;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int n = 0; n < 256; ++n) crc[k][n] = (crc[k - 1][n] >> 8) ^ crc[0][crc[k - 1][n] & 0xFF];
+        }
+    }
+
+    Uint32 crc32(Uint32 c, const Uint8* data, size_t size) const {
+        c = ~c;
+        for (; size >= 8; size -= 8, data += 8) {
+            c ^= data[0] | (data[1] << 8) | (data[2] << 16) | ((Uint32)data[3] << 24);
+            c = crc[7][c & 0xFF] ^ crc[6][(c >> 8) & 0xFF] ^ crc[5][(c >> 16) & 0xFF] ^ crc[4][c >> 24] ^
+                crc[3][data[4]] ^ crc[2][data[5]] ^ crc[1][data[6]] ^ crc[0][data[7]];
+        }
+        for (; size > 0; --size) c = crc[0][(c ^ *data++) & 0xFF] ^ (c >> 8);
+        return ~c;
+    }
+};
+
+inline const PngChecksums& pngChecksums() {
+    static const PngChecksums checksums;
+    return checksums;
+}
+
+inline Uint32 adler32(const Uint8* data, size_t size) {
+    Uint32 a = 1, b = 0;
+    while (size > 0) {
+        size_t n = size < 5552 ? size : 5552; // largest run before the sums can overflow
+        size -= n;
+        while (n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+inline void putBigEndian(std::vector<Uint8>& out, Uint32 v) {
+    out.push_back((Uint8)(v >> 24));
+    out.push_back((Uint8)(v >> 16));
+    out.push_back((Uint8)(v >> 8));
+    out.push_back((Uint8)v);
+}
+
+inline void putPngChunk(std::vector<Uint8>& out, const char* type, const Uint8* data, size_t size) {
+    putBigEndian(out, (Uint32)size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    putBigEndian(out, pngChecksums().crc32(0, &out[start], out.size() - start));
+}
+
+// scanlines holds height rows of a filter byte (0) and width RGB24 pixels
+inline void encodePng(const std::vector<Uint8>& scanlines, int width, int height, std::vector<Uint8>& out) {
+    static const Uint8 SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.clear();
+    out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+    std::vector<Uint8> header;
+    putBigEndian(header, (Uint32)width);
+    putBigEndian(header, (Uint32)height);
+    const Uint8 format[5] = {8, 2, 0, 0, 0}; // 8-bit RGB, deflate, adaptive filters, no interlace
+    header.insert(header.end(), format, format + 5);
+    putPngChunk(out, "IHDR", header.data(), header.size());
+
+    // zlib stream: header, stored blocks of up to 65535 bytes, Adler-32
+    const size_t BLOCK = 65535;
+    size_t blocks = (scanlines.size() + BLOCK - 1) / BLOCK;
+    std::vector<Uint8> zlib;
+    zlib.reserve(2 + scanlines.size() + blocks * 5 + 4);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    for (size_t offset = 0; offset < scanlines.size(); offset += BLOCK) {
+        size_t n = scanlines.size() - offset < BLOCK ? scanlines.size() - offset : BLOCK;
+        zlib.push_back(offset + n == scanlines.size() ? 1 : 0);
+        zlib.push_back((Uint8)n);
+        zlib.push_back((Uint8)(n >> 8));
+        zlib.push_back((Uint8)~n);
+        zlib.push_back((Uint8)(~n >> 8));
+        zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + n);
+    }
+    putBigEndian(zlib, adler32(scanlines.data(), scanlines.size()));
+    putPngChunk(out, "IDAT", zlib.data(), zlib.size());
+    putPngChunk(out, "IEND", nullptr, 0);
+}
+
+struct ExportSlot {
+    std::vector<Uint32> pixels;  // RGB888 read back from the renderer
+    std::vector<Uint8> scratch;  // PNG scanlines
+    std::vector<Uint8> encoded;  // bytes for the writer
+};
+
+// Three stages over a ring of slots, in frame order: the main thread renders
+// and reads back (capture), the converter turns the pixels into output bytes
+// with its own pool, and the writer puts them on disk. Frame k lives in slot
+// k % EXPORT_SLOTS, and captured >= converted >= written >= captured - EXPORT_SLOTS.
+class FrameExport {
+public:
+    ~FrameExport() { close(); }
+
+    bool enabled() const { return converter_.joinable(); }
+
+    // options.exportPath empty leaves the exporter disabled
+    bool open(const KioskOptions& options, int width, int height, double fps) {
+        if (options.exportPath.empty()) return true;
+        path_ = options.exportPath;
+        format_ = options.exportFormat;
+        width_ = width;
+        height_ = height;
+        if (format_ != "png") {
+            file_ = path_ == "-" ? stdout : fopen(path_.c_str(), "wb");
+            if (!file_) {
+                SDL_Log("Could not open export file '%s'", path_.c_str());
+                return false;
+            }
+            if (format_ == "y4m") {
+                // One header for the whole stream; C420jpeg is centered chroma, as exportYuvRows() averages it
+                fprintf(file_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, (int)(fps + 0.5));
+            }
+        }
+        slots_.assign(EXPORT_SLOTS, ExportSlot());
+        for (ExportSlot& slot : slots_) slot.pixels.resize((size_t)width * height);
+        captured_ = converted_ = written_ = 0;
+        stop_ = false;
+        failed_ = false;
+        bytes_ = 0;
+        started_ = SDL_GetPerformanceCounter();
+        pool_.reset(new ThreadPool(options.threads));
+        converter_ = std::thread(&FrameExport::converterLoop, this);
+        writer_ = std::thread(&FrameExport::writerLoop, this);
+        SDL_Log("Exporting %dx%d %s at %d fps to %s", width, height, format_.c_str(), (int)(fps + 0.5),
+                format_ == "png" ? exportFramePath(path_, 0).c_str() : path_ == "-" ? "stdout" : path_.c_str());
+        return true;
+    }
+
+    // Read the frame just rendered into the next slot, waiting while all of them
+    // are still being converted or written. False once a write has failed.
+    bool capture(SDL_Renderer* renderer) {
+        if (!enabled()) return true;
+        ExportSlot* slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return failed_ || captured_ < written_ + slots_.size(); });
+            if (failed_) return false;
+            slot = &slots_[captured_ % slots_.size()];
+        }
+        if (SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGB888, slot->pixels.data(), width_ * 4) != 0) {
+            SDL_Log("Could not read back the frame! SDL_Error: %s", SDL_GetError());
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++captured_;
+        }
+        wake_.notify_all();
+        return true;
+    }
+
+    // Finish everything captured, then stop the stage threads and log the throughput
+    bool close() {
+        if (!enabled()) return true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        converter_.join();
+        writer_.join();
+        pool_.reset();
+        if (file_ && file_ != stdout) fclose(file_);
+        if (file_ == stdout) fflush(stdout);
+        file_ = nullptr;
+        double seconds = (double)(SDL_GetPerformanceCounter() - started_) / SDL_GetPerformanceFrequency();
+        SDL_Log("Exported %llu frames, %.1f MB in %.2f s (%.1f fps)%s", (unsigned long long)written_,
+                bytes_ / 1048576.0, seconds, seconds > 0 ? written_ / seconds : 0.0, failed_ ? ", write failed" : "");
+        return !failed_;
+    }
+
+private:
+    void converterLoop() {
+        for (;;) {
+            ExportSlot* slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return converted_ < captured_ || stop_ || failed_; });
+                if (converted_ == captured_ || failed_) return;
+                slot = &slots_[converted_ % slots_.size()];
+            }
+            convert(*slot);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++converted_;
+            }
+            wake_.notify_all();
+        }
+    }
+
+    void convert(ExportSlot& slot) {
+        const Uint32* pixels = slot.pixels.data();
+        int width = width_;
+        int height = height_;
+        if (format_ == "y4m") {
+            static const char FRAME[] = "FRAME\n";
+            size_t lumaSize = (size_t)width * height;
+            size_t chromaSize = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+            slot.encoded.resize(6 + lumaSize + 2 * chromaSize);
+            memcpy(slot.encoded.data(), FRAME, 6);
+            Uint8* yPlane = slot.encoded.data() + 6;
+            Uint8* uPlane = yPlane + lumaSize;
+            Uint8* vPlane = uPlane + chromaSize;
+            pool_->parallelFor((height + 1) / 2, 8, [&](int cy0, int cy1) {
+                for (int cy = cy0; cy < cy1; ++cy) exportYuvRows(pixels, width, height, cy, yPlane, uPlane, vPlane);
+            });
+        } else if (format_ == "png") {
+            size_t stride = 1 + (size_t)width * 3;
+            slot.scratch.resize(stride * height);
+            Uint8* lines = slot.scratch.data();
+            pool_->parallelFor(height, 16, [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y) {
+                    lines[y * stride] = 0; // filter: none
+                    exportRgbRow(pixels + (size_t)y * width, width, lines + y * stride + 1);
+                }
+            });
+            encodePng(slot.scratch, width, height, slot.encoded);
+        } else {
+            slot.encoded.resize((size_t)width * height * 3);
+            Uint8* out = slot.encoded.data();
+            pool_->parallelFor(height, 16, [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y) exportRgbRow(pixels + (size_t)y * width, width, out + (size_t)y * width * 3);
+            });
+        }
+    }
+
+    void writerLoop() {
+        for (;;) {
+            ExportSlot* slot;
+            Uint64 index;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return written_ < converted_ || (stop_ && converted_ == captured_); });
+                if (written_ == converted_) return;
+                index = written_;
+                slot = &slots_[index % slots_.size()];
+            }
+            bool ok = write(*slot, index);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++written_;
+                bytes_ += slot->encoded.size();
+                if (!ok) failed_ = true;
+            }
+            done_.notify_all();
+            wake_.notify_all();
+            if (!ok) return;
+        }
+    }
+
+    bool write(const ExportSlot& slot, Uint64 index) {
+        if (format_ != "png") {
+            if (fwrite(slot.encoded.data(), 1, slot.encoded.size(), file_) == slot.encoded.size()) return true;
+            SDL_Log("Could not write frame %llu to '%s'", (unsigned long long)index, path_.c_str());
+            return false;
+        }
+        std::string name = exportFramePath(path_, index);
+        FILE* file = fopen(name.c_str(), "wb");
+        bool ok = file && fwrite(slot.encoded.data(), 1, slot.encoded.size(), file) == slot.encoded.size();
+        if (file && fclose(file) != 0) ok = false;
+        if (!ok) SDL_Log("Could not write '%s'", name.c_str());
+        return ok;
+    }
+
+    std::string path_;
+    std::string format_;
+    int width_ = 0;
+    int height_ = 0;
+    FILE* file_ = nullptr;
+    std::vector<ExportSlot> slots_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::thread converter_;
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable wake_;  // work for the converter or writer
+    std::condition_variable done_;  // a slot was freed
+    Uint64 captured_ = 0;
+    Uint64 converted_ = 0;
+    Uint64 written_ = 0;
+    Uint64 bytes_ = 0;
+    Uint64 started_ = 0;
+    bool stop_ = false;
+    bool failed_ = false;
+};
@@ -0,0 +1,186 @@
+// frame_pipeline.h
+// Producer/consumer frame pipeline: a producer thread shades upcoming frames into
+// staging buffers while the main thread uploads and presents the current one
+#pragma once
+#include <SDL2/SDL.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "indexed.h"
+#include "kiosk.h"
+#include "thread_pool.h"
+
+const int MAX_PIPELINE_DEPTH = 4;
+
+// --pipeline N: N staging buffers, so shading runs up to N-1 frames ahead of the
+// frame on screen; 2 is double buffering, 0 or 1 shades in the frame loop as before
+inline bool parsePipelineDepth(int argc, char* argv[], int& depth) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            depth = atoi(value);
+            if (depth < 0 || depth > MAX_PIPELINE_DEPTH) {
+                SDL_Log("Invalid pipeline depth '%s', expected 0 to %d", value, MAX_PIPELINE_DEPTH);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+struct StagedFrame {
+    float t = 0;                 // animation time the frame is shaded for
+    Uint64 shadeStart = 0;       // performance counter when the producer started on it
+    std::vector<Uint32> pixels;  // RGB888 rows, `width` apart
+    int width = 0;
+    int height = 0;
+    IndexedFrame indexed;        // --color indexed: indices and palette instead
+};
+
+// Copy (or expand through the palette) rows [row0, row1) of a staged frame into an RGB888 buffer
+inline void uploadStagedRows(const StagedFrame& staged, SimdLevel level, bool indexed, int row0, int row1,
+                             Uint32* pixels, int pitchPixels) {
+    for (int row = row0; row < row1; ++row) {
+        Uint32* out = pixels + (size_t)row * pitchPixels;
+        if (indexed) {
+            expandIndexedRow(level, staged.indexed.row(row), staged.indexed.palette, staged.indexed.width, out);
+        } else {
+            memcpy(out, &staged.pixels[(size_t)row * staged.width], (size_t)staged.width * 4);
+        }
+    }
+}
+
+// Frames are numbered in submission order and frame k lives in slot k % depth.
+// submitted >= shaded >= consumed, and at most `depth` frames are ahead of consumed,
+// so the queue (and with it the latency) stays bounded.
+class FramePipeline {
+public:
+    using ShadeFn = std::function<void(StagedFrame&, ThreadPool&)>;
+
+    ~FramePipeline() { stop(); }
+
+    bool running() const { return producer_.joinable(); }
+    int depth() const { return (int)slots_.size(); }
+
+    // The producer shades on its own pool, so the main thread keeps the frame pool
+    // for uploads and stars while the next frame is being shaded
+    void start(int depth, int threads, ShadeFn shade) {
+        stop();
+        slots_.assign(depth, StagedFrame());
+        shade_ = std::move(shade);
+        submitted_ = shaded_ = consumed_ = 0;
+        stop_ = false;
+        pool_.reset(new ThreadPool(threads));
+        producer_ = std::thread(&FramePipeline::producerLoop, this);
+    }
+
+    void stop() {
+        if (!running()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        producer_.join();
+        pool_.reset();
+    }
+
+    // Queue frames until the pipeline is full; timeAhead(k) is the animation
+    // time of the frame k frames after the one about to be acquired. Call it
+    // before acquire(): the frame acquired was shaded while the previous one was
+    // presented, and queueing its successors first keeps the producer shading
+    // while the main thread waits for and uploads it.
+    void fill(const std::function<float(int)>& timeAhead) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (submitted_ < consumed_ + slots_.size()) {
+                slots_[submitted_ % slots_.size()].t = timeAhead((int)(submitted_ - consumed_));
+                ++submitted_;
+            }
+        }
+        wake_.notify_all();
+    }
+
+    // Wait for the oldest queued frame, after fill(); it stays valid until release()
+    StagedFrame& acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return shaded_ > consumed_; });
+        return slots_[consumed_ % slots_.size()];
+    }
+
+    // Hand the acquired frame's buffer back to the producer
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++consumed_;
+    }
+
+    // Let the producer finish and drop everything queued, e.g. before the shading resolution changes
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return shaded_ == submitted_; });
+        consumed_ = shaded_;
+    }
+
+private:
+    void producerLoop() {
+        for (;;) {
+            StagedFrame* frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stop_ || submitted_ > shaded_; });
+                if (stop_) return;
+                frame = &slots_[shaded_ % slots_.size()];
+            }
+            frame->shadeStart = SDL_GetPerformanceCounter();
+            shade_(*frame, *pool_);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++shaded_;
+            }
+            done_.notify_all();
+        }
+    }
+
+    std::vector<StagedFrame> slots_;
+    ShadeFn shade_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::thread producer_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    Uint64 submitted_ = 0;
+    Uint64 shaded_ = 0;
+    Uint64 consumed_ = 0;
+    bool stop_ = false;
+};
+
+// Shade-to-present latency: from the moment shading of a frame starts until it has been presented
+struct LatencyStats {
+    double totalMs = 0;
+    double maxMs = 0;
+    Uint64 frames = 0;
+
+    void add(Uint64 shadeStart) {
+        double ms = (SDL_GetPerformanceCounter() - shadeStart) * 1000.0 / SDL_GetPerformanceFrequency();
+        totalMs += ms;
+        if (ms > maxMs) maxMs = ms;
+        ++frames;
+    }
+
+    double meanMs() const { return frames ? totalMs / frames : 0.0; }
+
+    // Log it and add it to the bench report
+    void report(FrameBench& bench) const {
+        if (frames == 0) return;
+        char value[32];
+        snprintf(value, sizeof(value), "%.3f", meanMs());
+        bench.addField("latency_ms", value);
+        SDL_Log("Shade-to-present latency: mean %.2f ms, max %.2f ms", meanMs(), maxMs);
+    }
+};
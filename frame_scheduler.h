@@ -0,0 +1,152 @@
+// frame_scheduler.h
+// Frame pacing against a deadline (or vsync) and elapsed-time animation clock
+#pragma once
+#include <SDL2/SDL.h>
+#include <cmath>
+#include "kiosk.h"
+
+// The effects were tuned one step per frame at 60 fps; frameTime() and
+// step() keep those units so existing constants still read naturally.
+const double ANIMATION_RATE = 60.0;
+const double MAX_FRAME_DELTA = 0.1; // seconds; longer stalls don't make animation jump
+
+// Narrow an animation time to float for the kernels. A float only resolves
+// 0.5 frames after 19 hours of uptime, so the time is first wrapped to a
+// period after which the effect repeats exactly; the wrap runs in double.
+inline float wrapAnimationTime(double t, double period) {
+    return (float)fmod(t, period);
+}
+
+struct FrameScheduler {
+    bool fixedStep = false;   // bench or --seed: every frame advances one period
+    bool paced = true;        // sleep to each deadline; off in bench mode
+    bool vsync = false;       // SDL_RenderPresent blocks on the display, never sleep
+    double hz = 60.0;
+    Uint64 frequency = 0;
+    Uint64 period = 0;        // counter ticks per frame
+    Uint64 origin = 0;
+    Uint64 deadline = 0;      // when the current frame should be on screen
+    Uint64 frameStart = 0;
+    Uint64 sleepMargin = 0;   // how late SDL_Delay wakes up; spun off instead of slept
+    double time = 0;          // seconds since start for the current frame
+    double delta = 0;         // seconds since the previous frame
+    bool degraded = false;    // the previous frame overran; skip optional work this frame
+    bool overran = false;
+    Uint64 frames = 0;
+    Uint64 skipped = 0;       // deadlines dropped instead of caught up
+    Uint64 degradedFrames = 0;
+    Uint64 sleeps = 0;
+    double overshootTotalMs = 0; // wake-up lateness after sleeping to a deadline
+    double overshootMaxMs = 0;
+
+    FrameScheduler(const KioskOptions& options, const Kiosk& kiosk)
+        : fixedStep(options.bench || options.seeded), paced(!options.bench), vsync(options.vsync && !options.bench) {
+        hz = options.fps > 0 && !vsync ? options.fps : (options.bench ? ANIMATION_RATE : kiosk.refreshRate);
+        frequency = SDL_GetPerformanceFrequency();
+        period = (Uint64)(frequency / hz);
+        sleepMargin = frequency / 1000;
+        origin = SDL_GetPerformanceCounter();
+        deadline = origin + period;
+        frameStart = origin;
+    }
+
+    // Start pacing over, so setup work (or time spent showing another effect) doesn't
+    // count as a late frame; the animation clock carries on from where it stopped
+    void restart() {
+        Uint64 now = SDL_GetPerformanceCounter();
+        origin = now - (Uint64)(time * frequency);
+        deadline = now + period;
+        frameStart = now;
+        overran = false;
+    }
+
+    // Animation time in 60 Hz frame units. Unbounded, so it stays a double;
+    // effects narrow it with wrapAnimationTime()
+    double frameTime() const { return time * ANIMATION_RATE; }
+
+    // Animation time `ahead` frames after the current one, for frames shaded in advance;
+    // exact under fixed steps, so pipelined bench runs render the same frames
+    double frameTimeAhead(int ahead) const {
+        double t = fixedStep ? (double)(frames + ahead) / hz : time + ahead / hz;
+        return t * ANIMATION_RATE;
+    }
+
+    // Elapsed time this frame in 60 Hz frame units, for per-frame motion
+    float step() const { return (float)(delta * ANIMATION_RATE); }
+
+    double periodMs() const { return 1000.0 / hz; }
+
+    // Time spent on the current frame so far
+    double workMs() const {
+        return (SDL_GetPerformanceCounter() - frameStart) * 1000.0 / frequency;
+    }
+
+    void beginFrame() {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (fixedStep) {
+            time = (double)frames / hz;
+            delta = 1.0 / hz;
+        } else {
+            time = (double)(now - origin) / frequency;
+            delta = frames == 0 ? 1.0 / hz : (double)(now - frameStart) / frequency;
+            if (delta > MAX_FRAME_DELTA) delta = MAX_FRAME_DELTA;
+        }
+        // With vsync a frame that took longer than 1.5 refreshes missed a vblank.
+        // Fixed steps never degrade, so seeded runs don't depend on timing.
+        degraded = fixedStep ? false : vsync ? frames > 0 && delta * hz > 1.5 : overran;
+        if (degraded) ++degradedFrames;
+        frameStart = now;
+    }
+
+    // Sleep until the next deadline. Late frames drop the deadlines they
+    // missed rather than rendering a burst of frames to catch up.
+    void endFrame() {
+        ++frames;
+        if (!paced || vsync) return;
+        Uint64 now = SDL_GetPerformanceCounter();
+        overran = now - frameStart > period;
+        if (now >= deadline) {
+            Uint64 late = now - deadline;
+            if (late >= period) {
+                skipped += late / period;
+                deadline = now + period;
+            } else {
+                deadline += period;
+            }
+            return;
+        }
+        Uint64 remaining = deadline - now;
+        if (remaining > sleepMargin) {
+            Uint32 ms = (Uint32)((remaining - sleepMargin) * 1000 / frequency);
+            if (ms > 0) {
+                Uint64 before = SDL_GetPerformanceCounter();
+                SDL_Delay(ms);
+                Uint64 slept = SDL_GetPerformanceCounter() - before;
+                Uint64 asked = (Uint64)ms * frequency / 1000;
+                // Track the OS wake-up latency: rise halfway toward late wake-ups,
+                // decay slowly, and stay within 0.25..2 ms so one preemption
+                // spike can't turn the whole frame into a spin
+                Uint64 late = slept > asked ? slept - asked : 0;
+                sleepMargin = late > sleepMargin ? (sleepMargin + late) / 2 : sleepMargin - sleepMargin / 16;
+                if (sleepMargin < frequency / 4000) sleepMargin = frequency / 4000;
+                if (sleepMargin > frequency / 500) sleepMargin = frequency / 500;
+            }
+        }
+        while ((now = SDL_GetPerformanceCounter()) < deadline) {
+        }
+        double overshootMs = (now - deadline) * 1000.0 / frequency;
+        overshootTotalMs += overshootMs;
+        if (overshootMs > overshootMaxMs) overshootMaxMs = overshootMs;
+        ++sleeps;
+        deadline += period;
+    }
+
+    void report() const {
+        if (!paced || frames == 0) return;
+        SDL_Log("Frame pacing: %llu frames at %.0f Hz%s, overshoot mean %.3f ms max %.3f ms, "
+                "%llu deadlines skipped, %llu degraded frames",
+                (unsigned long long)frames, hz, vsync ? " (vsync)" : "",
+                sleeps ? overshootTotalMs / sleeps : 0.0, overshootMaxMs,
+                (unsigned long long)skipped, (unsigned long long)degradedFrames);
+    }
+};
@@ -0,0 +1,158 @@
+// frame_trace.h
+// Per-stage frame timers kept in a fixed ring buffer and dumped as CSV or Chrome trace JSON
+#pragma once
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum TraceStage {
+    STAGE_COMPUTE,  // CPU pixel and simulation work
+    STAGE_UPLOAD,   // SDL_LockTexture / SDL_UnlockTexture
+    STAGE_COPY,     // SDL_RenderClear / SDL_RenderCopy
+    STAGE_DRAW,     // per-primitive renderer calls (stars, glyphs, shapes)
+    STAGE_PRESENT,  // SDL_RenderPresent
+    STAGE_EXPORT,   // --export: read-back, and waiting for a free export buffer
+    STAGE_COUNT
+};
+
+const char* const TRACE_STAGE_NAMES[STAGE_COUNT] = {"compute", "upload", "copy", "draw", "present", "export"};
+
+// Set from the SIGUSR1 handler; the main loop dumps at the end of the frame
+inline volatile sig_atomic_t traceDumpRequested = 0;
+
+inline void requestTraceDump(int) {
+    traceDumpRequested = 1;
+}
+
+const int MAX_TRACE_SEGMENTS = 16; // timed scopes kept per frame
+
+// Counter ticks relative to the start of the trace
+struct TraceSegment {
+    TraceStage stage;
+    Uint64 start;
+    Uint64 duration;
+};
+
+struct FrameRecord {
+    Uint64 start;
+    Uint64 total;
+    Uint64 stageTotal[STAGE_COUNT];
+    int segmentCount;
+    TraceSegment segments[MAX_TRACE_SEGMENTS];
+};
+
+struct FrameTrace {
+    bool enabled = false;
+    std::string path;        // .json writes Chrome trace events, anything else CSV
+    Uint64 budgetTicks = 0;  // frames whose work exceeds this count as missed
+    Uint64 origin = 0;
+    Uint64 missed = 0;
+    FrameRecord current = {};
+    std::vector<FrameRecord> ring;  // allocated once; the writer never allocates
+    std::atomic<Uint64> written{0}; // published frame count, readable from any thread
+
+    // capacity is the number of most recent frames kept for the dump
+    FrameTrace(const std::string& tracePath, double budgetMs, int capacity = 4096)
+        : enabled(!tracePath.empty()), path(tracePath) {
+        if (!enabled) return;
+        ring.resize(capacity);
+        budgetTicks = (Uint64)(budgetMs * SDL_GetPerformanceFrequency() / 1000.0);
+        origin = SDL_GetPerformanceCounter();
+#ifdef SIGUSR1
+        signal(SIGUSR1, requestTraceDump);
+#endif
+    }
+
+    ~FrameTrace() {
+        if (enabled) dump();
+    }
+
+    void beginFrame() {
+        if (!enabled) return;
+        current = FrameRecord();
+        current.start = SDL_GetPerformanceCounter() - origin;
+    }
+
+    // Stages may run more than once per frame; their times add up
+    void addStage(TraceStage stage, Uint64 begin, Uint64 end) {
+        current.stageTotal[stage] += end - begin;
+        if (current.segmentCount < MAX_TRACE_SEGMENTS) {
+            current.segments[current.segmentCount++] = {stage, begin - origin, end - begin};
+        }
+    }
+
+    void endFrame() {
+        if (!enabled) return;
+        current.total = SDL_GetPerformanceCounter() - origin - current.start;
+        if (current.total > budgetTicks) ++missed;
+        Uint64 n = written.load(std::memory_order_relaxed);
+        ring[n % ring.size()] = current;
+        written.store(n + 1, std::memory_order_release);
+        if (traceDumpRequested) {
+            traceDumpRequested = 0;
+            dump();
+        }
+    }
+
+    void dump() const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) {
+            SDL_Log("Could not write trace to %s", path.c_str());
+            return;
+        }
+        Uint64 n = written.load(std::memory_order_acquire);
+        Uint64 first = n > ring.size() ? n - ring.size() : 0;
+        double usPerTick = 1e6 / SDL_GetPerformanceFrequency();
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        if (json) {
+            fprintf(file, "{\"displayTimeUnit\": \"ms\", \"otherData\": {\"frames\": %llu, \"missed_frames\": %llu},\n \"traceEvents\": [\n",
+                    (unsigned long long)n, (unsigned long long)missed);
+        } else {
+            fprintf(file, "frame,start_us,total_us");
+            for (int s = 0; s < STAGE_COUNT; ++s) fprintf(file, ",%s_us", TRACE_STAGE_NAMES[s]);
+            fprintf(file, ",missed\n");
+        }
+        for (Uint64 i = first; i < n; ++i) {
+            const FrameRecord& r = ring[i % ring.size()];
+            bool late = r.total > budgetTicks;
+            if (json) {
+                fprintf(file, "%s  {\"name\": \"frame %llu\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.1f, \"dur\": %.1f}",
+                        i == first ? "" : ",\n", (unsigned long long)i, late ? "missed" : "frame",
+                        r.start * usPerTick, r.total * usPerTick);
+                for (int k = 0; k < r.segmentCount; ++k) {
+                    const TraceSegment& segment = r.segments[k];
+                    fprintf(file, ",\n  {\"name\": \"%s\", \"cat\": \"stage\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.1f, \"dur\": %.1f}",
+                            TRACE_STAGE_NAMES[segment.stage], segment.start * usPerTick, segment.duration * usPerTick);
+                }
+            } else {
+                fprintf(file, "%llu,%.1f,%.1f", (unsigned long long)i, r.start * usPerTick, r.total * usPerTick);
+                for (int s = 0; s < STAGE_COUNT; ++s) fprintf(file, ",%.1f", r.stageTotal[s] * usPerTick);
+                fprintf(file, ",%d\n", late ? 1 : 0);
+            }
+        }
+        if (json) fprintf(file, "\n]}\n");
+        fclose(file);
+        SDL_Log("Trace: %llu frames, %llu over budget, written to %s",
+                (unsigned long long)n, (unsigned long long)missed, path.c_str());
+    }
+};
+
+// Times the enclosing block as one stage; a single branch when tracing is off
+class TraceScope {
+public:
+    TraceScope(FrameTrace& trace, TraceStage stage)
+        : trace_(trace), stage_(stage), begin_(trace.enabled ? SDL_GetPerformanceCounter() : 0) {}
+    ~TraceScope() {
+        if (trace_.enabled) trace_.addStage(stage_, begin_, SDL_GetPerformanceCounter());
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    FrameTrace& trace_;
+    TraceStage stage_;
+    Uint64 begin_;
+};
@@ -0,0 +1,682 @@
+// galaxy.h
+// Spiral galaxy shader shared by the effects that draw a galaxy background
+#pragma once
+#include <SDL2/SDL.h>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "anim_cache.h"
+#include "fixed_point.h"
+#include "frame_pipeline.h"
+#include "frame_scheduler.h"
+#include "indexed.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "verify.h"
+
+struct GalaxyStyle {
+    float coreGlow;   // brightness from the core alone
+    float armGlow;    // brightness from the spiral arms
+    float red, green, blue; // channel scale for the brightness
+    float coreBlue;   // extra blue from the core
+};
+
+// Blueish/purple arms, no yellow core
+const GalaxyStyle GALAXY_BACKGROUND = {0.15f, 0.85f, 80.0f, 40.0f, 180.0f, 60.0f};
+
+// Reference shader for one pixel of a width x height frame
+inline Uint32 galaxyColor(int x, int y, float t, int width, int height, const GalaxyStyle& style) {
+    float cx = 0.5f * width;
+    float cy = 0.5f * height;
+    float dx = x - cx;
+    float dy = y - cy;
+    float r = sqrtf(dx * dx + dy * dy);
+    float angle = atan2f(dy, dx);
+    // Spiral arms: modulate angle by radius and time
+    float spiral = sinf(4.0f * angle + r * 0.025f - t * 0.012f);
+    float core = expf(-r * 0.002f);
+    float arms = 0.5f + 0.5f * spiral;
+    float c = style.coreGlow * core + style.armGlow * arms * core;
+    Uint8 rC = (Uint8)(style.red * c);
+    Uint8 gC = (Uint8)(style.green * c);
+    Uint8 bC = (Uint8)(style.blue * c + style.coreBlue * core);
+    return (rC << 16) | (gC << 8) | bC;
+}
+
+// One row of samples at x = x0 + i * step, i < count
+inline void galaxyRowScalar(const GalaxyStyle& style, int width, int height, float t,
+                            int y, int x0, int step, int count, Uint32* out) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = galaxyColor(x0 + i * step, y, t, width, height, style);
+    }
+}
+
+// Color mapping shared by the vector kernels: spiral in [-1, 1], core in (0, 1]
+template <class F, class I>
+SIMD_INLINE I galaxyMap(const GalaxyStyle& style, const F& spiral, const F& core) {
+    F arms = 0.5f + 0.5f * spiral;
+    F c = style.coreGlow * core + style.armGlow * arms * core;
+    I rC = __builtin_convertvector(style.red * c, I);
+    I gC = __builtin_convertvector(style.green * c, I);
+    I bC = __builtin_convertvector(style.blue * c + style.coreBlue * core, I);
+    return (rC << 16) | (gC << 8) | bC;
+}
+
+// Vector version of galaxyColor() for lanes at offsets (dx, dy) and radius r.
+// Approximated sin/atan2/exp keep every channel within one level of the reference.
+template <class F, class I>
+SIMD_INLINE I galaxyShade(const GalaxyStyle& style, const F& dx, const F& dy, const F& r, float timePhase) {
+    F angle = simdAtan2(dy, dx);
+    F spiral = simdSin<F, I>(4.0f * angle + r * 0.025f - timePhase);
+    F core = simdExp<F, I>(r * -0.002f);
+    return galaxyMap<F, I>(style, spiral, core);
+}
+
+#if defined(SIMD_X86)
+SIMD_TARGET_SSE2 inline void galaxyRowSse2(const GalaxyStyle& style, int width, int height, float t,
+                                           int y, int x0, int step, int count, Uint32* out) {
+    float cy = 0.5f * height;
+    f32x4 dx = simdRamp<f32x4>() * (float)step + (x0 - 0.5f * width);
+    f32x4 dy = simdSplat<f32x4>(y - cy);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        f32x4 r = _mm_sqrt_ps(dx * dx + dy * dy);
+        simdStore(out + i, galaxyShade<f32x4, i32x4>(style, dx, dy, r, t * 0.012f));
+        dx += 4.0f * step;
+    }
+    galaxyRowScalar(style, width, height, t, y, x0 + i * step, step, count - i, out + i);
+}
+
+SIMD_TARGET_AVX2 inline void galaxyRowAvx2(const GalaxyStyle& style, int width, int height, float t,
+                                           int y, int x0, int step, int count, Uint32* out) {
+    float cy = 0.5f * height;
+    f32x8 dx = simdRamp<f32x8>() * (float)step + (x0 - 0.5f * width);
+    f32x8 dy = simdSplat<f32x8>(y - cy);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        f32x8 r = _mm256_sqrt_ps(dx * dx + dy * dy);
+        simdStore(out + i, galaxyShade<f32x8, i32x8>(style, dx, dy, r, t * 0.012f));
+        dx += 8.0f * step;
+    }
+    galaxyRowScalar(style, width, height, t, y, x0 + i * step, step, count - i, out + i);
+}
+#elif defined(SIMD_ARM)
+inline void galaxyRowNeon(const GalaxyStyle& style, int width, int height, float t,
+                          int y, int x0, int step, int count, Uint32* out) {
+    float cy = 0.5f * height;
+    f32x4 dx = simdRamp<f32x4>() * (float)step + (x0 - 0.5f * width);
+    f32x4 dy = simdSplat<f32x4>(y - cy);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        f32x4 r = vsqrtq_f32(dx * dx + dy * dy);
+        simdStore(out + i, galaxyShade<f32x4, i32x4>(style, dx, dy, r, t * 0.012f));
+        dx += 4.0f * step;
+    }
+    galaxyRowScalar(style, width, height, t, y, x0 + i * step, step, count - i, out + i);
+}
+#endif
+
+// Shade one row with the selected instruction set; SIMD_SCALAR is the reference
+inline void renderGalaxyRow(SimdLevel level, const GalaxyStyle& style, int width, int height, float t,
+                            int y, int x0, int step, int count, Uint32* out) {
+    switch (level) {
+#if defined(SIMD_X86)
+        case SIMD_AVX2: galaxyRowAvx2(style, width, height, t, y, x0, step, count, out); return;
+        case SIMD_SSE2: galaxyRowSse2(style, width, height, t, y, x0, step, count, out); return;
+#elif defined(SIMD_ARM)
+        case SIMD_NEON: galaxyRowNeon(style, width, height, t, y, x0, step, count, out); return;
+#endif
+        default: galaxyRowScalar(style, width, height, t, y, x0, step, count, out); return;
+    }
+}
+
+// Everything in galaxyColor() except the time term depends only on the pixel,
+// so it is computed once per sample grid: the spiral phase 4*angle + r*0.025
+// as a 16-bit fraction of a turn and expf(-r*0.002) as 16-bit fixed point.
+// A frame then costs one sine and the color mapping per sample.
+struct GalaxyField {
+    int width = 0;   // frame size the samples cover
+    int height = 0;
+    int step = 1;    // sample spacing in pixels
+    int cols = 0;
+    int rows = 0;
+    std::vector<Uint16> phase; // turns * 65536
+    std::vector<Uint16> core;  // exp(-r * 0.002) * 65535
+};
+
+const float GALAXY_PHASE_SCALE = 6.2831853071795865f / 65536.0f;
+const float GALAXY_CORE_SCALE = 1.0f / 65535.0f;
+
+inline size_t galaxyFieldBytes(const GalaxyField& field) {
+    return (field.phase.size() + field.core.size()) * sizeof(Uint16);
+}
+
+// Sample x = col * step, y = row * step of a width x height frame, like renderGalaxyRow()
+inline void buildGalaxyField(GalaxyField& field, int width, int height, int step, ThreadPool& pool) {
+    field.width = width;
+    field.height = height;
+    field.step = step;
+    field.cols = (width + step - 1) / step;
+    field.rows = (height + step - 1) / step;
+    field.phase.assign((size_t)field.cols * field.rows, 0);
+    field.core.assign((size_t)field.cols * field.rows, 0);
+    pool.parallelFor(field.rows, 16, [&](int row0, int row1) {
+        for (int row = row0; row < row1; ++row) {
+            float dy = row * step - 0.5f * height;
+            for (int col = 0; col < field.cols; ++col) {
+                float dx = col * step - 0.5f * width;
+                float r = sqrtf(dx * dx + dy * dy);
+                double turns = (4.0 * atan2f(dy, dx) + r * 0.025) / 6.283185307179586;
+                turns -= floor(turns);
+                size_t i = (size_t)row * field.cols + col;
+                field.phase[i] = (Uint16)((Uint32)lround(turns * 65536.0) & 0xFFFF);
+                field.core[i] = (Uint16)lround(expf(-r * 0.002f) * 65535.0f);
+            }
+        }
+    });
+    SDL_Log("Galaxy field cache: %dx%d samples, %.1f KiB", field.cols, field.rows, galaxyFieldBytes(field) / 1024.0);
+}
+
+// The galaxy depends on time only through t * 0.012, so it repeats exactly
+// every 2*pi / 0.012 frames
+const double GALAXY_PERIOD = 6.283185307179586 / 0.012;
+
+// The scheduler's time for the galaxy kernels
+inline float galaxyTime(double t) {
+    return wrapAnimationTime(t, GALAXY_PERIOD);
+}
+
+// Time term for the cached shaders, reduced to one turn so float keeps its precision
+inline float galaxyTimePhase(float t) {
+    return (float)fmod(t * 0.012, 6.283185307179586);
+}
+
+inline void galaxyFieldRowScalar(const GalaxyStyle& style, const GalaxyField& field, float timePhase,
+                                 int row, int col0, int count, Uint32* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols + col0];
+    const Uint16* core = &field.core[(size_t)row * field.cols + col0];
+    for (int i = 0; i < count; ++i) {
+        float spiral = sinf(phase[i] * GALAXY_PHASE_SCALE - timePhase);
+        float c0 = core[i] * GALAXY_CORE_SCALE;
+        float arms = 0.5f + 0.5f * spiral;
+        float c = style.coreGlow * c0 + style.armGlow * arms * c0;
+        Uint8 rC = (Uint8)(style.red * c);
+        Uint8 gC = (Uint8)(style.green * c);
+        Uint8 bC = (Uint8)(style.blue * c + style.coreBlue * c0);
+        out[i] = (rC << 16) | (gC << 8) | bC;
+    }
+}
+
+template <class F, class I, class H>
+SIMD_INLINE I galaxyFieldShade(const GalaxyStyle& style, const Uint16* phase, const Uint16* core, float timePhase) {
+    F spiral = simdSin<F, I>(simdLoadU16<F, H>(phase) * GALAXY_PHASE_SCALE - timePhase);
+    return galaxyMap<F, I>(style, spiral, simdLoadU16<F, H>(core) * GALAXY_CORE_SCALE);
+}
+
+#if defined(SIMD_X86)
+SIMD_TARGET_SSE2 inline void galaxyFieldRowSse2(const GalaxyStyle& style, const GalaxyField& field, float timePhase,
+                                                int row, Uint32* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols];
+    const Uint16* core = &field.core[(size_t)row * field.cols];
+    int i = 0;
+    for (; i + 4 <= field.cols; i += 4) {
+        simdStore(out + i, galaxyFieldShade<f32x4, i32x4, u16x4>(style, phase + i, core + i, timePhase));
+    }
+    galaxyFieldRowScalar(style, field, timePhase, row, i, field.cols - i, out + i);
+}
+
+SIMD_TARGET_AVX2 inline void galaxyFieldRowAvx2(const GalaxyStyle& style, const GalaxyField& field, float timePhase,
+                                                int row, Uint32* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols];
+    const Uint16* core = &field.core[(size_t)row * field.cols];
+    int i = 0;
+    for (; i + 8 <= field.cols; i += 8) {
+        simdStore(out + i, galaxyFieldShade<f32x8, i32x8, u16x8>(style, phase + i, core + i, timePhase));
+    }
+    galaxyFieldRowScalar(style, field, timePhase, row, i, field.cols - i, out + i);
+}
+#elif defined(SIMD_ARM)
+inline void galaxyFieldRowNeon(const GalaxyStyle& style, const GalaxyField& field, float timePhase,
+                               int row, Uint32* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols];
+    const Uint16* core = &field.core[(size_t)row * field.cols];
+    int i = 0;
+    for (; i + 4 <= field.cols; i += 4) {
+        simdStore(out + i, galaxyFieldShade<f32x4, i32x4, u16x4>(style, phase + i, core + i, timePhase));
+    }
+    galaxyFieldRowScalar(style, field, timePhase, row, i, field.cols - i, out + i);
+}
+#endif
+
+// Shade one row of the cached sample grid (field.cols samples) at time t
+inline void renderGalaxyFieldRow(SimdLevel level, const GalaxyStyle& style, const GalaxyField& field, float t,
+                                 int row, Uint32* out) {
+    float timePhase = galaxyTimePhase(t);
+    switch (level) {
+#if defined(SIMD_X86)
+        case SIMD_AVX2: galaxyFieldRowAvx2(style, field, timePhase, row, out); return;
+        case SIMD_SSE2: galaxyFieldRowSse2(style, field, timePhase, row, out); return;
+#elif defined(SIMD_ARM)
+        case SIMD_NEON: galaxyFieldRowNeon(style, field, timePhase, row, out); return;
+#endif
+        default: galaxyFieldRowScalar(style, field, timePhase, row, 0, field.cols, out); return;
+    }
+}
+
+// Indexed galaxy: arms and core each quantized to 16 levels with a 4x4
+// ordered dither (transposed for the core so the two patterns differ), the
+// index is arms * 16 + core and the palette depends only on the style.
+const int GALAXY_LEVELS = 16;
+
+inline void buildGalaxyPalette(const GalaxyStyle& style, Uint32* palette) {
+    for (int a = 0; a < GALAXY_LEVELS; ++a) {
+        for (int k = 0; k < GALAXY_LEVELS; ++k) {
+            float arms = a / (GALAXY_LEVELS - 1.0f);
+            float core = k / (GALAXY_LEVELS - 1.0f);
+            float c = style.coreGlow * core + style.armGlow * arms * core;
+            Uint8 rC = (Uint8)(style.red * c);
+            Uint8 gC = (Uint8)(style.green * c);
+            Uint8 bC = (Uint8)(style.blue * c + style.coreBlue * core);
+            palette[a * GALAXY_LEVELS + k] = (rC << 16) | (gC << 8) | bC;
+        }
+    }
+}
+
+inline void galaxyFieldIndexRowScalar(const GalaxyField& field, float timePhase, int row, int col0, int count, Uint8* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols + col0];
+    const Uint16* core = &field.core[(size_t)row * field.cols + col0];
+    for (int i = 0; i < count; ++i) {
+        int col = col0 + i;
+        float arms = 0.5f + 0.5f * sinf(phase[i] * GALAXY_PHASE_SCALE - timePhase);
+        int a = (int)(arms * (GALAXY_LEVELS - 1) + (BAYER_4X4[row & 3][col & 3] + 0.5f) / 16.0f);
+        int k = (int)(core[i] * GALAXY_CORE_SCALE * (GALAXY_LEVELS - 1) + (BAYER_4X4[col & 3][row & 3] + 0.5f) / 16.0f);
+        out[i] = (Uint8)((a < GALAXY_LEVELS ? a : GALAXY_LEVELS - 1) * GALAXY_LEVELS + (k < GALAXY_LEVELS ? k : GALAXY_LEVELS - 1));
+    }
+}
+
+// Dither thresholds for lane i at column i of the row (vector loops start at column 0)
+template <class F> SIMD_INLINE void galaxyDither(int row, F& armsDither, F& coreDither) {
+    for (int i = 0; i < (int)(sizeof(F) / sizeof(float)); ++i) {
+        armsDither[i] = (BAYER_4X4[row & 3][i & 3] + 0.5f) / 16.0f;
+        coreDither[i] = (BAYER_4X4[i & 3][row & 3] + 0.5f) / 16.0f;
+    }
+}
+
+template <class F, class I, class H>
+SIMD_INLINE I galaxyFieldIndex(const Uint16* phase, const Uint16* core, float timePhase,
+                               const F& armsDither, const F& coreDither) {
+    const float top = GALAXY_LEVELS - 1.0f;
+    F arms = 0.5f + 0.5f * simdSin<F, I>(simdLoadU16<F, H>(phase) * GALAXY_PHASE_SCALE - timePhase);
+    F a = simdMin(arms * top + armsDither, simdSplat<F>(top));
+    F k = simdMin(simdLoadU16<F, H>(core) * (GALAXY_CORE_SCALE * top) + coreDither, simdSplat<F>(top));
+    return __builtin_convertvector(a, I) * GALAXY_LEVELS + __builtin_convertvector(k, I);
+}
+
+#if defined(SIMD_X86)
+SIMD_TARGET_SSE2 inline void galaxyFieldIndexRowSse2(const GalaxyField& field, float timePhase, int row, Uint8* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols];
+    const Uint16* core = &field.core[(size_t)row * field.cols];
+    f32x4 armsDither, coreDither;
+    galaxyDither(row, armsDither, coreDither);
+    int i = 0;
+    for (; i + 4 <= field.cols; i += 4) {
+        i32x4 index = galaxyFieldIndex<f32x4, i32x4, u16x4>(phase + i, core + i, timePhase, armsDither, coreDither);
+        simdStoreU8(out + i, index);
+    }
+    galaxyFieldIndexRowScalar(field, timePhase, row, i, field.cols - i, out + i);
+}
+
+SIMD_TARGET_AVX2 inline void galaxyFieldIndexRowAvx2(const GalaxyField& field, float timePhase, int row, Uint8* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols];
+    const Uint16* core = &field.core[(size_t)row * field.cols];
+    f32x8 armsDither, coreDither;
+    galaxyDither(row, armsDither, coreDither);
+    int i = 0;
+    for (; i + 8 <= field.cols; i += 8) {
+        i32x8 index = galaxyFieldIndex<f32x8, i32x8, u16x8>(phase + i, core + i, timePhase, armsDither, coreDither);
+        simdStoreU8(out + i, index);
+    }
+    galaxyFieldIndexRowScalar(field, timePhase, row, i, field.cols - i, out + i);
+}
+#elif defined(SIMD_ARM)
+inline void galaxyFieldIndexRowNeon(const GalaxyField& field, float timePhase, int row, Uint8* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols];
+    const Uint16* core = &field.core[(size_t)row * field.cols];
+    f32x4 armsDither, coreDither;
+    galaxyDither(row, armsDither, coreDither);
+    int i = 0;
+    for (; i + 4 <= field.cols; i += 4) {
+        i32x4 index = galaxyFieldIndex<f32x4, i32x4, u16x4>(phase + i, core + i, timePhase, armsDither, coreDither);
+        simdStoreU8(out + i, index);
+    }
+    galaxyFieldIndexRowScalar(field, timePhase, row, i, field.cols - i, out + i);
+}
+#endif
+
+// One row of 8-bit indices into the buildGalaxyPalette() palette
+inline void renderGalaxyFieldIndexRow(SimdLevel level, const GalaxyField& field, float t, int row, Uint8* out) {
+    float timePhase = galaxyTimePhase(t);
+    switch (level) {
+#if defined(SIMD_X86)
+        case SIMD_AVX2: galaxyFieldIndexRowAvx2(field, timePhase, row, out); return;
+        case SIMD_SSE2: galaxyFieldIndexRowSse2(field, timePhase, row, out); return;
+#elif defined(SIMD_ARM)
+        case SIMD_NEON: galaxyFieldIndexRowNeon(field, timePhase, row, out); return;
+#endif
+        default: galaxyFieldIndexRowScalar(field, timePhase, row, 0, field.cols, out); return;
+    }
+}
+
+enum GalaxyEngine {
+    GALAXY_CACHED,  // float shading from the time-independent field
+    GALAXY_DIRECT,  // every sample shaded from scratch
+    GALAXY_FIXED,   // integer-only field and shading
+};
+
+inline const char* galaxyEngineName(GalaxyEngine engine) {
+    switch (engine) {
+        case GALAXY_DIRECT: return "direct";
+        case GALAXY_FIXED: return "fixed";
+        default: return "cached";
+    }
+}
+
+// --galaxy cached (default), direct to shade every sample from scratch, or fixed for the integer engine
+inline bool parseGalaxyEngine(int argc, char* argv[], GalaxyEngine& engine) {
+    engine = GALAXY_CACHED;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--galaxy") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (strcmp(name, "cached") == 0) {
+                engine = GALAXY_CACHED;
+            } else if (strcmp(name, "direct") == 0) {
+                engine = GALAXY_DIRECT;
+            } else if (strcmp(name, "fixed") == 0) {
+                engine = GALAXY_FIXED;
+            } else {
+                SDL_Log("Unknown galaxy engine '%s', expected 'cached', 'direct' or 'fixed'", name);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Fixed-point engine for CPUs without a fast FPU. The field holds the same
+// samples as buildGalaxyField(), computed with isqrt64, fixAtan2 and a table
+// of the core falloff per whole pixel of radius. Frames take one table sine
+// and integer color weights per sample. Against the float engine the field
+// differs by at most 2 units in phase and 1 in core, a shaded channel by at
+// most 1 of 255, and under 0.1% of indexed samples land one level off
+// (measured over a full period at 1920x1080).
+inline void buildGalaxyFieldFixed(GalaxyField& field, int width, int height, int step, ThreadPool& pool) {
+    field.width = width;
+    field.height = height;
+    field.step = step;
+    field.cols = (width + step - 1) / step;
+    field.rows = (height + step - 1) / step;
+    field.phase.assign((size_t)field.cols * field.rows, 0);
+    field.core.assign((size_t)field.cols * field.rows, 0);
+    // exp(-r * 0.002) * 65535 per whole pixel of radius, filled once
+    int maxRadius = (int)isqrt64((Uint64)width * width + (Uint64)height * height) / 2 + 2;
+    std::vector<Sint32> falloff(maxRadius + 2);
+    for (int r = 0; r < (int)falloff.size(); ++r) {
+        falloff[r] = (Sint32)lround(exp(-r * 0.002) * 65535.0);
+    }
+    // r * 0.025 radians of spiral twist, for r in Q8
+    const Uint64 twist = (Uint64)llround(0.025 * FIX_RADIAN);
+    pool.parallelFor(field.rows, 16, [&](int row0, int row1) {
+        for (int row = row0; row < row1; ++row) {
+            // Doubled offsets from the center keep odd sizes exact
+            Sint64 dy2 = 2 * (Sint64)row * step - height;
+            for (int col = 0; col < field.cols; ++col) {
+                Sint64 dx2 = 2 * (Sint64)col * step - width;
+                Uint32 rQ8 = isqrt64((Uint64)(dx2 * dx2 + dy2 * dy2) << 14);
+                Uint32 angle = 4 * fixAtan2(dy2, dx2) + (Uint32)((rQ8 * twist) >> 8);
+                int whole = (int)(rQ8 >> 8);
+                int frac = (int)(rQ8 & 0xFF);
+                size_t i = (size_t)row * field.cols + col;
+                field.phase[i] = (Uint16)((angle + 0x8000u) >> 16);
+                field.core[i] = (Uint16)(falloff[whole] + (((falloff[whole + 1] - falloff[whole]) * frac) >> 8));
+            }
+        }
+    });
+    SDL_Log("Galaxy field cache (fixed): %dx%d samples, %.1f KiB", field.cols, field.rows,
+            galaxyFieldBytes(field) / 1024.0);
+}
+
+// Style weights for the integer shaders: glows in Q15, channel scales in Q8
+struct GalaxyFixedStyle {
+    Uint32 coreGlow, armGlow;
+    Uint32 red, green, blue, coreBlue;
+};
+
+inline GalaxyFixedStyle makeGalaxyFixedStyle(const GalaxyStyle& style) {
+    return {(Uint32)lround(style.coreGlow * 32768.0), (Uint32)lround(style.armGlow * 32768.0),
+            (Uint32)lround(style.red * 256.0), (Uint32)lround(style.green * 256.0),
+            (Uint32)lround(style.blue * 256.0), (Uint32)lround(style.coreBlue * 256.0)};
+}
+
+// galaxyFieldRowScalar() in integers: timeAngle is t * 0.012 as a fixed_point.h angle
+inline void galaxyFieldRowFixed(const GalaxyFixedStyle& style, const GalaxyField& field, Uint32 timeAngle,
+                                int row, Uint32* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols];
+    const Uint16* core = &field.core[(size_t)row * field.cols];
+    for (int i = 0; i < field.cols; ++i) {
+        int spiral = fixSin(((Uint32)phase[i] << 16) - timeAngle);
+        Uint32 arms = (Uint32)(FIX_SIN_ONE + spiral) >> 1;  // 0.5 + 0.5 * spiral, Q14
+        Uint32 c0 = core[i] >> 1;                           // Q15
+        Uint32 c = ((style.coreGlow * c0) >> 15) + ((style.armGlow * ((arms * c0) >> 14)) >> 15);
+        Uint32 rC = (style.red * c) >> 23;
+        Uint32 gC = (style.green * c) >> 23;
+        Uint32 bC = (((style.blue * c) >> 1) + ((style.coreBlue * c0) >> 1)) >> 22;
+        out[i] = (rC << 16) | (gC << 8) | bC;
+    }
+}
+
+// galaxyFieldIndexRowScalar() in integers, quantized and dithered in Q15
+inline void galaxyFieldIndexRowFixed(const GalaxyField& field, Uint32 timeAngle, int row, Uint8* out) {
+    const Uint16* phase = &field.phase[(size_t)row * field.cols];
+    const Uint16* core = &field.core[(size_t)row * field.cols];
+    for (int col = 0; col < field.cols; ++col) {
+        Uint32 arms = (Uint32)(FIX_SIN_ONE + fixSin(((Uint32)phase[col] << 16) - timeAngle)) >> 1;
+        int a = (int)((arms * 2 * (GALAXY_LEVELS - 1) + (2 * BAYER_4X4[row & 3][col & 3] + 1) * 1024) >> 15);
+        int k = (int)(((Uint32)core[col] * (GALAXY_LEVELS - 1) / 2 + (2 * BAYER_4X4[col & 3][row & 3] + 1) * 1024) >> 15);
+        out[col] = (Uint8)((a < GALAXY_LEVELS ? a : GALAXY_LEVELS - 1) * GALAXY_LEVELS + (k < GALAXY_LEVELS ? k : GALAXY_LEVELS - 1));
+    }
+}
+
+// The field an engine shades from; the direct engine needs none
+inline void buildGalaxyEngineField(GalaxyEngine engine, GalaxyField& field, int width, int height, int step,
+                                   ThreadPool& pool) {
+    if (engine == GALAXY_FIXED) {
+        buildGalaxyFieldFixed(field, width, height, step, pool);
+    } else if (engine == GALAXY_CACHED) {
+        buildGalaxyField(field, width, height, step, pool);
+    }
+}
+
+// One frame's inputs to the engine row shaders. makeGalaxyShade() does the
+// float work once per frame, so the fixed engine's rows stay integer-only.
+struct GalaxyShade {
+    GalaxyEngine engine;
+    SimdLevel level;
+    GalaxyStyle style;
+    float t;
+    GalaxyFixedStyle fixedStyle;  // GALAXY_FIXED only
+    Uint32 timeAngle;             // t * 0.012 as an angle, GALAXY_FIXED only
+};
+
+inline GalaxyShade makeGalaxyShade(GalaxyEngine engine, SimdLevel level, const GalaxyStyle& style, float t) {
+    GalaxyShade shade = {engine, level, style, t, {}, 0};
+    if (engine == GALAXY_FIXED) {
+        shade.fixedStyle = makeGalaxyFixedStyle(style);
+        shade.timeAngle = fixAngleOf(t * 0.012);
+    }
+    return shade;
+}
+
+// One row of samples at y = row * step of a width x height frame, with the chosen engine
+inline void renderGalaxyEngineRow(const GalaxyShade& shade, const GalaxyField& field, int width, int height,
+                                  int step, int row, Uint32* out) {
+    switch (shade.engine) {
+        case GALAXY_FIXED:
+            galaxyFieldRowFixed(shade.fixedStyle, field, shade.timeAngle, row, out);
+            return;
+        case GALAXY_DIRECT:
+            renderGalaxyRow(shade.level, shade.style, width, height, shade.t, row * step, 0, step,
+                            (width + step - 1) / step, out);
+            return;
+        default:
+            renderGalaxyFieldRow(shade.level, shade.style, field, shade.t, row, out);
+            return;
+    }
+}
+
+// Indexed rows need a field, so the direct engine has none
+inline void renderGalaxyEngineIndexRow(const GalaxyShade& shade, const GalaxyField& field, int row, Uint8* out) {
+    if (shade.engine == GALAXY_FIXED) {
+        galaxyFieldIndexRowFixed(field, shade.timeAngle, row, out);
+    } else {
+        renderGalaxyFieldIndexRow(shade.level, field, shade.t, row, out);
+    }
+}
+
+// A cached loop samples GALAXY_PERIOD (about 8.7 s at 60 fps) evenly
+const int GALAXY_ANIM_FRAMES = 524;  // about one per 60 Hz frame
+// Bump whenever any galaxy kernel's output changes, so loops cached by older
+// shading code are rebuilt instead of replayed
+const Uint32 GALAXY_KERNEL_REVISION = 1;
+
+// Cached frame closest to time t
+inline int galaxyAnimFrame(float t, int frames) {
+    int frame = (int)(galaxyTimePhase(t) / 6.2831853f * frames + 0.5f);
+    return frame % frames;
+}
+
+// Map the galaxy loop at width x height sampled every step pixels, rendering it
+// into path with the given engine first when the file is missing or stale. The
+// file doesn't name the effect, so effects sharing a style share one cache. The
+// field is only built when frames have to be rendered, so a warm start skips it.
+// The engine needs a field, so GALAXY_DIRECT can't be cached.
+inline bool loadGalaxyAnimCache(const std::string& path, GalaxyEngine engine, const GalaxyStyle& style,
+                                int width, int height, int step, bool indexed, SimdLevel level,
+                                ThreadPool& pool, GalaxyField& field, AnimCache& cache) {
+    int cols = (width + step - 1) / step;
+    int rows = (height + step - 1) / step;
+    Uint64 params = animCacheHash(&style, sizeof(style));
+    int sizes[6] = {width, height, step, GALAXY_LEVELS, (int)engine, (int)GALAXY_KERNEL_REVISION};
+    params = animCacheHash(sizes, sizeof(sizes), params);
+    params = animCacheHash(&GALAXY_PERIOD, sizeof(GALAXY_PERIOD), params);
+    AnimCacheHeader header = makeAnimCacheHeader("galaxy", cols, rows, indexed ? ANIM_CACHE_INDEXED : ANIM_CACHE_RGB,
+                                                 GALAXY_ANIM_FRAMES, params);
+    if (openAnimCache(path, header, cache)) {
+        SDL_Log("Animation cache %s: %d frames of %dx%d, mapped", path.c_str(), GALAXY_ANIM_FRAMES, cols, rows);
+        return true;
+    }
+    buildGalaxyEngineField(engine, field, width, height, step, pool);
+    Uint32 palette[INDEXED_COLORS] = {};
+    buildGalaxyPalette(style, palette);
+    bool written = writeAnimCache(path, header, palette, [&](int index, Uint8* out) {
+        GalaxyShade shade = makeGalaxyShade(engine, level, style, (float)(index * GALAXY_PERIOD / GALAXY_ANIM_FRAMES));
+        pool.parallelFor(rows, 8, [&](int row0, int row1) {
+            for (int row = row0; row < row1; ++row) {
+                if (indexed) {
+                    renderGalaxyEngineIndexRow(shade, field, row, out + (size_t)row * cols);
+                } else {
+                    renderGalaxyEngineRow(shade, field, width, height, step, row, (Uint32*)out + (size_t)row * cols);
+                }
+            }
+        });
+    });
+    return written && openAnimCache(path, header, cache);
+}
+
+// Shade a whole background frame for staged.t into a staging buffer, for --pipeline:
+// RGB888 or palette indices at the texture size
+inline void shadeGalaxyFrame(GalaxyEngine engine, SimdLevel level, const GalaxyStyle& style, const GalaxyField& field,
+                             int width, int height, int step, bool indexed, StagedFrame& staged, ThreadPool& pool) {
+    int cols = (width + step - 1) / step;
+    int rows = (height + step - 1) / step;
+    if (indexed) {
+        if (staged.indexed.width != cols || staged.indexed.height != rows) {
+            staged.indexed.resize(cols, rows);
+            buildGalaxyPalette(style, staged.indexed.palette);
+        }
+    } else {
+        staged.width = cols;
+        staged.height = rows;
+        staged.pixels.resize((size_t)cols * rows);
+    }
+    GalaxyShade shade = makeGalaxyShade(engine, level, style, staged.t);
+    pool.parallelFor(rows, 8, [&](int row0, int row1) {
+        for (int row = row0; row < row1; ++row) {
+            if (indexed) {
+                renderGalaxyEngineIndexRow(shade, field, row, staged.indexed.row(row));
+            } else {
+                renderGalaxyEngineRow(shade, field, width, height, step, row, &staged.pixels[(size_t)row * cols]);
+            }
+        }
+    });
+}
+
+// --verify tolerances against galaxyColor(), with headroom over the measured
+// errors: vector sines differ from sinf() in the last bits (1 level), the
+// cached and fixed phase is quantized to 1/65536 turn (1 level), and indexed
+// frames to 16x16 arm and core levels (up to 23 levels on the bright background)
+const VerifyTolerance GALAXY_TOLERANCE[] = {
+    {2, 60.0},  // cached
+    {1, 80.0},  // direct
+    {2, 60.0},  // fixed
+};
+const VerifyTolerance GALAXY_INDEXED_TOLERANCE = {28, 34.0};
+
+// --verify for a galaxy shaded with `style` at 1/step resolution: every engine and
+// instruction set against galaxyColor() at the same sample points
+inline void verifyGalaxy(VerifyRun& run, const char* effect, const GalaxyStyle& style, int step) {
+    Uint32 palette[INDEXED_COLORS];
+    buildGalaxyPalette(style, palette);
+    for (const auto& size : run.sizes) {
+        int width = size.first;
+        int height = size.second;
+        int cols = (width + step - 1) / step;
+        int rows = (height + step - 1) / step;
+        run.reference(effect, width, height, (size_t)cols * rows, [&](float t, Uint32* out) {
+            run.pool.parallelFor(rows, 8, [&](int row0, int row1) {
+                for (int row = row0; row < row1; ++row) {
+                    galaxyRowScalar(style, width, height, t, row * step, 0, step, cols, out + (size_t)row * cols);
+                }
+            });
+        });
+        GalaxyField field;
+        for (GalaxyEngine engine : {GALAXY_DIRECT, GALAXY_CACHED, GALAXY_FIXED}) {
+            buildGalaxyEngineField(engine, field, width, height, step, run.pool);
+            for (SimdLevel level : verifySimdLevels()) {
+                // The fixed engine has no vector kernels
+                if (engine == GALAXY_FIXED && level != SIMD_SCALAR) break;
+                std::string name = galaxyEngineName(engine);
+                if (engine != GALAXY_FIXED) name = name + "/" + simdLevelName(level);
+                run.kernel(name, GALAXY_TOLERANCE[engine], [&](float t, Uint32* out) {
+                    GalaxyShade shade = makeGalaxyShade(engine, level, style, t);
+                    run.pool.parallelFor(rows, 8, [&](int row0, int row1) {
+                        for (int row = row0; row < row1; ++row) {
+                            renderGalaxyEngineRow(shade, field, width, height, step, row, out + (size_t)row * cols);
+                        }
+                    });
+                });
+                if (engine == GALAXY_DIRECT) continue;
+                run.kernel(name + "/indexed", GALAXY_INDEXED_TOLERANCE, [&](float t, Uint32* out) {
+                    GalaxyShade shade = makeGalaxyShade(engine, level, style, t);
+                    run.pool.parallelFor(rows, 8, [&](int row0, int row1) {
+                        std::vector<Uint8> index(cols);
+                        for (int row = row0; row < row1; ++row) {
+                            renderGalaxyEngineIndexRow(shade, field, row, index.data());
+                            expandIndexedRow(level, index.data(), palette, cols, out + (size_t)row * cols);
+                        }
+                    });
+                });
+            }
+        }
+    }
+}
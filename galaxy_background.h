@@ -0,0 +1,237 @@
+// galaxy_background.h
+// The galaxy background of plasma_stars and alliens: options, field, texture, adaptive
+// resolution, anim cache and pipeline, so each effect only draws its overlay on top
+#pragma once
+#include <SDL2/SDL.h>
+#include <functional>
+#include <string>
+#include "adaptive_resolution.h"
+#include "effect.h"
+#include "frame_pipeline.h"
+#include "galaxy.h"
+#include "indexed.h"
+#include "starfield.h"
+
+class GalaxyBackground {
+public:
+    // Called for each band of STAR_BAND_ROWS texture rows while the texture is
+    // locked, by the worker that wrote it, e.g. to splat stars into the background
+    using Overlay = std::function<void(int row0, int row1, Uint32* pixels, int pitchPixels)>;
+
+    GalaxyBackground(const char* effect, const GalaxyStyle& style) : effect_(effect), style_(style) {}
+
+    // Texture rows are 1/divisor() of the screen
+    int divisor() const { return resolution_.divisor; }
+
+    // Parse --scale, --filter, --galaxy, --anim-cache and --pipeline, then build the
+    // field or map the cached loop; adds the background's fields to the bench report
+    bool init(EffectContext& ctx) {
+        const KioskOptions& options = ctx.options;
+        if (!parseResolutionOptions(ctx.argc, ctx.argv, resolutionOptions_) ||
+            !parseGalaxyEngine(ctx.argc, ctx.argv, engine_) ||
+            !parseAnimCachePath(ctx.argc, ctx.argv, animCachePath_) ||
+            !parsePipelineDepth(ctx.argc, ctx.argv, pipelineDepth_)) {
+            return false;
+        }
+        if (options.indexed && engine_ == GALAXY_DIRECT) {
+            SDL_Log("--color indexed needs a galaxy field, not --galaxy direct");
+            return false;
+        }
+        if (!animCachePath_.empty() && engine_ == GALAXY_DIRECT) {
+            SDL_Log("--anim-cache needs a galaxy field, not --galaxy direct");
+            return false;
+        }
+        width_ = ctx.kiosk.width;
+        height_ = ctx.kiosk.height;
+        // The galaxy is shaded at 1/divisor resolution and stretched by SDL_RenderCopy.
+        // A cached loop is rendered for one resolution, so it fixes the divisor too.
+        bool fixedResolution = options.bench || options.seeded || !animCachePath_.empty();
+        resolution_ = AdaptiveResolution(resolutionOptions_, fixedResolution, ctx.scheduler.periodMs());
+        ctx.bench.addField("scale", "1/" + std::to_string(resolution_.divisor));
+        SDL_Log("Galaxy kernel: %s, %s", engine_ == GALAXY_FIXED ? "integer" : simdLevelName(options.simd),
+                galaxyEngineName(engine_));
+        if (!animCachePath_.empty()) {
+            if (!loadGalaxyAnimCache(animCachePath_, engine_, style_, width_, height_, resolution_.divisor,
+                                     options.indexed, options.simd, ctx.pool, field_, animCache_)) {
+                return false;
+            }
+        } else {
+            buildGalaxyEngineField(engine_, field_, width_, height_, resolution_.divisor, ctx.pool);
+        }
+        ctx.bench.addField("galaxy", animCache_.map ? "anim-cache" : galaxyEngineName(engine_));
+        // A cached loop is only copied, so there is nothing to shade ahead
+        if (animCache_.map) {
+            pipelineDepth_ = 0;
+        }
+        ctx.bench.addField("pipeline", std::to_string(pipelineDepth_ > 1 ? pipelineDepth_ : 0));
+        // Indexed mode: the palette only depends on the style, so it is built once
+        if (options.indexed && !animCache_.map) {
+            frame_.resize(field_.cols, field_.rows);
+            buildGalaxyPalette(style_, frame_.palette);
+        }
+        ctx.bench.addField("color", options.indexed ? "indexed" : "rgb");
+        return true;
+    }
+
+    // (Re)create the texture at the current divisor and start the producer on first use
+    bool resize(EffectContext& ctx) {
+        if (texture_) SDL_DestroyTexture(texture_);
+        texture_ = createBackgroundTexture(ctx.kiosk.renderer, width_, height_, resolution_.divisor,
+                                           resolutionOptions_.linear);
+        valid_ = false;
+        if (pipelineDepth_ > 1 && !pipeline_.running()) {
+            SimdLevel simd = ctx.options.simd;
+            bool indexed = ctx.options.indexed;
+            pipelineDivisor_ = resolution_.divisor;
+            pipeline_.start(pipelineDepth_, ctx.options.threads, [this, simd, indexed](StagedFrame& staged, ThreadPool& pool) {
+                shadeGalaxyFrame(engine_, simd, style_, field_, width_, height_, pipelineDivisor_, indexed, staged, pool);
+            });
+        }
+        return texture_ != nullptr;
+    }
+
+    // Bring the texture up to date and copy it over the cleared screen. Under load
+    // the previous texture is reused, unless an overlay has to be redrawn into it.
+    void render(EffectContext& ctx, const Overlay& overlay) {
+        const KioskOptions& options = ctx.options;
+        FrameTrace& trace = ctx.trace;
+        ThreadPool& pool = ctx.pool;
+        SDL_Renderer* renderer = ctx.kiosk.renderer;
+        shadeStart_ = 0;
+        if (pipeline_.running()) {
+            // Shaded ahead by the producer (see FramePipeline::fill)
+            StagedFrame* staged;
+            {
+                TraceScope scope(trace, STAGE_COMPUTE);
+                pipeline_.fill([&](int ahead) { return galaxyTime(ctx.scheduler.frameTimeAhead(ahead)); });
+                staged = &pipeline_.acquire();
+            }
+            TraceScope scope(trace, STAGE_UPLOAD);
+            void* pixels;
+            int pitch;
+            SDL_LockTexture(texture_, NULL, &pixels, &pitch);
+            Uint32* buf = (Uint32*)pixels;
+            int rows = options.indexed ? staged->indexed.height : staged->height;
+            pool.parallelFor(rows, STAR_BAND_ROWS, [&](int row0, int row1) {
+                uploadStagedRows(*staged, options.simd, options.indexed, row0, row1, buf, pitch / 4);
+                if (overlay) overlay(row0, row1, buf, pitch / 4);
+            });
+            SDL_UnlockTexture(texture_);
+            shadeStart_ = staged->shadeStart;
+            pipeline_.release();
+            valid_ = true;
+        } else if (!ctx.scheduler.degraded || !valid_ || overlay) {
+            shadeStart_ = SDL_GetPerformanceCounter();
+            float t = galaxyTime(ctx.scheduler.frameTime());
+            GalaxyShade shade = makeGalaxyShade(engine_, options.simd, style_, t);
+            if (options.indexed && !animCache_.map) {
+                // Before the lock (see IndexedFrame)
+                TraceScope scope(trace, STAGE_COMPUTE);
+                pool.parallelFor(field_.rows, 8, [&](int row0, int row1) {
+                    for (int row = row0; row < row1; ++row) {
+                        renderGalaxyEngineIndexRow(shade, field_, row, frame_.row(row));
+                    }
+                });
+            }
+            void* pixels;
+            int pitch;
+            {
+                TraceScope scope(trace, STAGE_UPLOAD);
+                SDL_LockTexture(texture_, NULL, &pixels, &pitch);
+            }
+            Uint32* buf = (Uint32*)pixels;
+            if (animCache_.map) {
+                // One period was rendered ahead of time; the frame is streamed from the mapped file
+                TraceScope scope(trace, STAGE_UPLOAD);
+                int index = galaxyAnimFrame(t, (int)animCache_.header.frames);
+                pool.parallelFor((int)animCache_.header.height, STAR_BAND_ROWS, [&](int row0, int row1) {
+                    streamAnimCacheRows(animCache_, options.simd, index, row0, row1, buf, pitch / 4);
+                    if (overlay) overlay(row0, row1, buf, pitch / 4);
+                });
+            } else if (options.indexed) {
+                TraceScope scope(trace, STAGE_UPLOAD);
+                pool.parallelFor(frame_.height, STAR_BAND_ROWS, [&](int row0, int row1) {
+                    for (int row = row0; row < row1; ++row) {
+                        expandIndexedRow(options.simd, frame_.row(row), frame_.palette, frame_.width,
+                                         buf + row * (pitch / 4));
+                    }
+                    if (overlay) overlay(row0, row1, buf, pitch / 4);
+                });
+            } else {
+                TraceScope scope(trace, STAGE_COMPUTE);
+                int step = resolution_.divisor;
+                int sampleRows = (height_ + step - 1) / step;
+                pool.parallelFor(sampleRows, STAR_BAND_ROWS, [&](int row0, int row1) {
+                    for (int row = row0; row < row1; ++row) {
+                        renderGalaxyEngineRow(shade, field_, width_, height_, step, row, buf + row * (pitch / 4));
+                    }
+                    if (overlay) overlay(row0, row1, buf, pitch / 4);
+                });
+            }
+            {
+                TraceScope scope(trace, STAGE_UPLOAD);
+                SDL_UnlockTexture(texture_);
+            }
+            valid_ = true;
+        }
+        TraceScope scope(trace, STAGE_COPY);
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture_, NULL, NULL);
+    }
+
+    // Record the latency and adapt the resolution; false if the new texture can't be created
+    bool endFrame(EffectContext& ctx) {
+        if (shadeStart_) {
+            latency_.add(shadeStart_);
+        }
+        if (!resolution_.update(ctx.scheduler.workMs())) {
+            return true;
+        }
+        // The producer reads the field and divisor; let it finish and drop what it queued
+        pipeline_.drain();
+        pipelineDivisor_ = resolution_.divisor;
+        if (!resize(ctx)) {
+            return false;
+        }
+        buildGalaxyEngineField(engine_, field_, width_, height_, resolution_.divisor, ctx.pool);
+        if (ctx.options.indexed) {
+            frame_.resize(field_.cols, field_.rows);
+        }
+        return true;
+    }
+
+    void report(EffectContext& ctx) { latency_.report(ctx.bench); }
+
+    // Every engine at the default 1/2 resolution, and the clock it is shaded with
+    void verify(VerifyRun& run) const {
+        verifyGalaxy(run, effect_, style_, 2);
+        verifyAnimationClock(run, effect_, "clock/galaxy", GALAXY_PERIOD);
+    }
+
+    void release() {
+        pipeline_.stop();
+        if (texture_) SDL_DestroyTexture(texture_);
+        texture_ = nullptr;
+        closeAnimCache(animCache_);
+    }
+
+private:
+    const char* effect_;
+    GalaxyStyle style_;
+    ResolutionOptions resolutionOptions_;
+    GalaxyEngine engine_ = GALAXY_CACHED;
+    std::string animCachePath_;
+    int width_ = 0;
+    int height_ = 0;
+    AdaptiveResolution resolution_;
+    GalaxyField field_;
+    AnimCache animCache_;
+    IndexedFrame frame_;
+    SDL_Texture* texture_ = nullptr;
+    bool valid_ = false;        // a fresh texture has to be shaded even under load
+    int pipelineDepth_ = 0;
+    int pipelineDivisor_ = 1;   // resolution the producer shades at; only changes while it is drained
+    FramePipeline pipeline_;
+    LatencyStats latency_;
+    Uint64 shadeStart_ = 0;     // when shading of the background being drawn started, 0 if it is reused
+};
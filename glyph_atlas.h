@@ -0,0 +1,75 @@
+// glyph_atlas.h
+// Printable ASCII rasterized once into a white atlas texture, drawn through a QuadBatch
+#pragma once
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include "quad_batch.h"
+
+const int ATLAS_FIRST_CHAR = 32;
+const int ATLAS_GLYPHS = 96;   // ' ' .. DEL
+const int ATLAS_COLUMNS = 16;
+const int ATLAS_PADDING = 1;   // transparent gap so filtering never picks up a neighbour
+
+struct GlyphAtlas {
+    SDL_Texture* texture = nullptr;
+    int width = 0;
+    int height = 0;
+    SDL_FRect uv[ATLAS_GLYPHS];  // texture coordinates of each glyph, normalized
+};
+
+// Render every glyph in white; the vertex colors tint and fade them when drawn
+inline bool buildGlyphAtlas(SDL_Renderer* renderer, TTF_Font* font, GlyphAtlas& atlas) {
+    SDL_Surface* glyphs[ATLAS_GLYPHS] = {};
+    const SDL_Color white = {255, 255, 255, 255};
+    int cellW = 1;
+    int cellH = 1;
+    for (int i = 0; i < ATLAS_GLYPHS; ++i) {
+        glyphs[i] = TTF_RenderGlyph_Blended(font, (Uint16)(ATLAS_FIRST_CHAR + i), white);
+        if (!glyphs[i]) continue;
+        if (glyphs[i]->w > cellW) cellW = glyphs[i]->w;
+        if (glyphs[i]->h > cellH) cellH = glyphs[i]->h;
+    }
+    cellW += ATLAS_PADDING;
+    cellH += ATLAS_PADDING;
+    int rows = (ATLAS_GLYPHS + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+    atlas.width = ATLAS_COLUMNS * cellW;
+    atlas.height = rows * cellH;
+    SDL_Surface* sheet = SDL_CreateRGBSurfaceWithFormat(0, atlas.width, atlas.height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (sheet) {
+        for (int i = 0; i < ATLAS_GLYPHS; ++i) {
+            SDL_Rect cell = {(i % ATLAS_COLUMNS) * cellW, (i / ATLAS_COLUMNS) * cellH, 0, 0};
+            int w = glyphs[i] ? glyphs[i]->w : 0;
+            int h = glyphs[i] ? glyphs[i]->h : 0;
+            if (glyphs[i]) {
+                // Copy the glyph's alpha as is instead of blending it onto the empty sheet
+                SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+                SDL_BlitSurface(glyphs[i], NULL, sheet, &cell);
+            }
+            atlas.uv[i] = {(float)cell.x / atlas.width, (float)cell.y / atlas.height,
+                           (float)w / atlas.width, (float)h / atlas.height};
+        }
+        atlas.texture = SDL_CreateTextureFromSurface(renderer, sheet);
+        SDL_FreeSurface(sheet);
+    }
+    for (SDL_Surface* glyph : glyphs) {
+        if (glyph) SDL_FreeSurface(glyph);
+    }
+    if (!atlas.texture) {
+        SDL_Log("Glyph atlas could not be created! SDL_Error: %s", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(atlas.texture, SDL_BLENDMODE_BLEND);
+    SDL_Log("Glyph atlas: %d glyphs in %dx%d", ATLAS_GLYPHS, atlas.width, atlas.height);
+    return true;
+}
+
+inline void destroyGlyphAtlas(GlyphAtlas& atlas) {
+    if (atlas.texture) SDL_DestroyTexture(atlas.texture);
+    atlas.texture = nullptr;
+}
+
+inline void addGlyph(QuadBatch& batch, const GlyphAtlas& atlas, char c, const SDL_FRect& dst, SDL_Color color) {
+    int i = (Uint8)c - ATLAS_FIRST_CHAR;
+    if (i < 0 || i >= ATLAS_GLYPHS) return;
+    addQuad(batch, dst, atlas.uv[i], color);
+}
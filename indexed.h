@@ -0,0 +1,65 @@
+// indexed.h
+// 8-bit indexed frames: kernels write one byte per pixel, a 256-color palette expands them on upload
+#pragma once
+#include <SDL2/SDL.h>
+#include <vector>
+#include "simd.h"
+
+const int INDEXED_COLORS = 256;
+
+// Ordered dither thresholds (in sixteenths) for kernels that quantize smooth values
+const Uint8 BAYER_4X4[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5},
+};
+
+// Kernels shade indices into an IndexedFrame before the texture is locked; expanding
+// them through the palette into the locked texture is the whole upload, so the
+// texture stays locked only for a palette lookup per pixel
+struct IndexedFrame {
+    int width = 0;
+    int height = 0;
+    std::vector<Uint8> pixels;
+    Uint32 palette[INDEXED_COLORS] = {};
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        pixels.assign((size_t)w * h, 0);
+    }
+
+    Uint8* row(int y) { return &pixels[(size_t)y * width]; }
+    const Uint8* row(int y) const { return &pixels[(size_t)y * width]; }
+};
+
+inline void expandIndexedRowScalar(const Uint8* index, const Uint32* palette, int count, Uint32* out) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = palette[index[i]];
+    }
+}
+
+#if defined(SIMD_X86)
+// 8 pixels per gather from the palette, which stays in L1
+SIMD_TARGET_AVX2 inline void expandIndexedRowAvx2(const Uint8* index, const Uint32* palette, int count, Uint32* out) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(index + i)));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_i32gather_epi32((const int*)palette, lanes, 4));
+    }
+    expandIndexedRowScalar(index + i, palette, count - i, out + i);
+}
+#endif
+
+// Palette lookups only gain from hardware gathers; other levels use the scalar loop
+inline void expandIndexedRow(SimdLevel level, const Uint8* index, const Uint32* palette, int count, Uint32* out) {
+#if defined(SIMD_X86)
+    if (level == SIMD_AVX2) {
+        expandIndexedRowAvx2(index, palette, count, out);
+        return;
+    }
+#endif
+    (void)level;
+    expandIndexedRowScalar(index, palette, count, out);
+}
@@ -0,0 +1,286 @@
+// kiosk.h
+// Command-line options, full-screen kiosk setup and the headless benchmark shared by all effects
+#pragma once
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "simd.h"
+
+struct KioskOptions {
+    bool bench = false;     // --bench: offscreen, unthrottled, prints a JSON report
+    int frames = 1000;      // --frames N: frames to render in bench mode
+    int width = 0;          // --size WxH: bench render size (0 = 1920x1080)
+    int height = 0;
+    int threads = 0;        // --threads N: render threads (1 = main thread only, 0 = one per core)
+    SimdLevel simd = SIMD_SCALAR; // --simd scalar|sse2|avx2|neon|auto
+    std::string tracePath;  // --trace PATH: per-stage frame trace (.csv or .json), dumped on exit and SIGUSR1
+    double budgetMs = 1000.0 / 60; // --budget-ms X: frame work budget for the missed-frame counter
+    int fps = 0;            // --fps N: target frame rate (0 = display refresh rate)
+    bool vsync = false;     // --vsync: pace frames with the display instead of sleeping
+    bool indexed = false;   // --color rgb|indexed: 8-bit palette frames expanded on upload
+    Uint64 seed = 0;        // --seed N: random seed (default: from the clock)
+    bool seeded = false;    // a fixed seed also fixes the time step, so runs repeat frame for frame
+    std::string exportPath; // --export PATH: headless bench run that writes every frame ("-" = stdout)
+    std::string exportFormat; // --export-format raw|y4m|png (default: from the extension, else raw)
+    bool verify = false;    // --verify: compare the fast kernels with the reference formulas and exit
+    std::string goldenPath; // --golden PATH: frame hashes --verify checks against, recorded if missing
+};
+
+// Parse the options every effect understands. Effect-specific options are
+// left alone so each main() can scan argv for its own ones afterwards.
+inline bool parseKioskOptions(int argc, char* argv[], KioskOptions& options) {
+    options.simd = detectSimdLevel();
+    options.threads = SDL_GetCPUCount();
+    for (int i = 1; i < argc; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(argv[i], "--bench") == 0) {
+            options.bench = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && value) {
+            options.frames = atoi(value);
+            ++i;
+            if (options.frames <= 0) {
+                SDL_Log("Invalid frame count '%s'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--size") == 0 && value) {
+            ++i;
+            if (sscanf(value, "%dx%d", &options.width, &options.height) != 2 ||
+                options.width <= 0 || options.height <= 0) {
+                SDL_Log("Invalid size '%s', expected WIDTHxHEIGHT", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && value) {
+            ++i;
+            char* end = nullptr;
+            long n = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || n < 0) {
+                SDL_Log("Invalid thread count '%s'", value);
+                return false;
+            }
+            options.threads = n == 0 ? SDL_GetCPUCount() : (int)n;
+        } else if (strcmp(argv[i], "--trace") == 0 && value) {
+            options.tracePath = value;
+            ++i;
+        } else if (strcmp(argv[i], "--budget-ms") == 0 && value) {
+            options.budgetMs = atof(value);
+            ++i;
+            if (options.budgetMs <= 0) {
+                SDL_Log("Invalid frame budget '%s'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--fps") == 0 && value) {
+            options.fps = atoi(value);
+            ++i;
+            if (options.fps < 0) {
+                SDL_Log("Invalid frame rate '%s'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--vsync") == 0) {
+            options.vsync = true;
+        } else if (strcmp(argv[i], "--color") == 0 && value) {
+            ++i;
+            if (strcmp(value, "indexed") == 0) {
+                options.indexed = true;
+            } else if (strcmp(value, "rgb") == 0) {
+                options.indexed = false;
+            } else {
+                SDL_Log("Unknown color mode '%s', expected 'rgb' or 'indexed'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--simd") == 0 && value) {
+            ++i;
+            if (!parseSimdLevel(value, options.simd)) {
+                SDL_Log("Unknown SIMD level '%s'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && value) {
+            ++i;
+            char* end = nullptr;
+            options.seed = strtoull(value, &end, 10);
+            if (end == value || *end != '\0') {
+                SDL_Log("Invalid seed '%s'", value);
+                return false;
+            }
+            options.seeded = true;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            options.verify = true;
+        } else if (strcmp(argv[i], "--golden") == 0 && value) {
+            options.goldenPath = value;
+            ++i;
+        } else if (strcmp(argv[i], "--export") == 0 && value) {
+            options.exportPath = value;
+            ++i;
+        } else if (strcmp(argv[i], "--export-format") == 0 && value) {
+            options.exportFormat = value;
+            ++i;
+            if (options.exportFormat != "raw" && options.exportFormat != "y4m" && options.exportFormat != "png") {
+                SDL_Log("Unknown export format '%s', expected 'raw', 'y4m' or 'png'", value);
+                return false;
+            }
+        }
+    }
+    // Export renders like a bench run: offscreen, fixed steps, as fast as possible
+    if (!options.exportPath.empty()) {
+        options.bench = true;
+        const std::string& path = options.exportPath;
+        if (options.exportFormat.empty()) {
+            std::string ext = path.size() > 4 ? path.substr(path.size() - 4) : "";
+            options.exportFormat = ext == ".y4m" ? "y4m" : ext == ".png" ? "png" : "raw";
+        }
+        if (options.exportFormat == "png" && path == "-") {
+            SDL_Log("PNG export writes one file per frame and needs a path");
+            return false;
+        }
+    }
+    if (!options.seeded) {
+        options.seed = (Uint64)time(nullptr) ^ SDL_GetPerformanceCounter();
+    }
+    return true;
+}
+
+struct Kiosk {
+    SDL_Window* window = nullptr;
+    SDL_Renderer* renderer = nullptr;
+    int width = 0;
+    int height = 0;
+    int refreshRate = 60; // display refresh in Hz, 60 when unknown or offscreen
+};
+
+// Initialize SDL and open the full-screen kiosk window, or in bench mode a
+// hidden window on the dummy video driver with the software renderer.
+inline bool openKiosk(const char* title, const KioskOptions& options, Kiosk& kiosk) {
+    if (options.bench) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    }
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        SDL_Log("SDL could not initialize! SDL_Error: %s", SDL_GetError());
+        return false;
+    }
+
+    if (options.bench) {
+        kiosk.width = options.width ? options.width : 1920;
+        kiosk.height = options.height ? options.height : 1080;
+    } else {
+        SDL_DisplayMode displayMode;
+        if (SDL_GetCurrentDisplayMode(0, &displayMode) != 0) {
+            SDL_Log("Could not get display mode! SDL_Error: %s", SDL_GetError());
+            SDL_Quit();
+            return false;
+        }
+        kiosk.width = displayMode.w;
+        kiosk.height = displayMode.h;
+        if (displayMode.refresh_rate > 0) {
+            kiosk.refreshRate = displayMode.refresh_rate;
+        }
+    }
+
+    kiosk.window = SDL_CreateWindow(
+        title,
+        SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        kiosk.width,
+        kiosk.height,
+        options.bench ? SDL_WINDOW_HIDDEN : SDL_WINDOW_FULLSCREEN
+    );
+    if (!kiosk.window) {
+        SDL_Log("Window could not be created! SDL_Error: %s", SDL_GetError());
+        SDL_Quit();
+        return false;
+    }
+
+    Uint32 rendererFlags = SDL_RENDERER_ACCELERATED;
+    if (options.bench) {
+        rendererFlags = SDL_RENDERER_SOFTWARE;
+    } else if (options.vsync) {
+        rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    kiosk.renderer = SDL_CreateRenderer(kiosk.window, -1, rendererFlags);
+    if (!kiosk.renderer) {
+        SDL_Log("Renderer could not be created! SDL_Error: %s", SDL_GetError());
+        SDL_DestroyWindow(kiosk.window);
+        SDL_Quit();
+        return false;
+    }
+
+    if (!options.seeded) {
+        SDL_Log("Random seed %llu (pass --seed to repeat this run)", (unsigned long long)options.seed);
+    }
+
+    if (!options.bench) {
+        // Kiosk-like settings
+        SDL_SetWindowFullscreen(kiosk.window, SDL_WINDOW_FULLSCREEN_DESKTOP);
+        SDL_SetWindowBordered(kiosk.window, SDL_FALSE);
+        SDL_SetWindowAlwaysOnTop(kiosk.window, SDL_TRUE);
+        SDL_SetWindowGrab(kiosk.window, SDL_TRUE);
+        SDL_ShowCursor(SDL_DISABLE);
+        SDL_RaiseWindow(kiosk.window);
+        SDL_SetHint(SDL_HINT_GRAB_KEYBOARD, "1");
+        SDL_SetWindowInputFocus(kiosk.window);
+    }
+    return true;
+}
+
+inline void closeKiosk(Kiosk& kiosk) {
+    SDL_DestroyRenderer(kiosk.renderer);
+    SDL_DestroyWindow(kiosk.window);
+    SDL_Quit();
+}
+
+// Per-frame wall-clock times for the --bench report
+struct FrameBench {
+    bool enabled = false;
+    int frames = 0;
+    Uint64 frameStart = 0;
+    std::vector<double> frameMs;
+    std::vector<std::pair<std::string, std::string>> fields; // effect-specific report fields
+
+    explicit FrameBench(const KioskOptions& options) : enabled(options.bench), frames(options.frames) {
+        if (enabled) frameMs.reserve(frames);
+    }
+
+    void addField(const char* key, const std::string& value) {
+        fields.emplace_back(key, value);
+    }
+
+    void beginFrame() {
+        if (enabled) frameStart = SDL_GetPerformanceCounter();
+    }
+
+    // Returns true once the requested number of frames has been rendered
+    bool endFrame() {
+        if (!enabled) return false;
+        Uint64 elapsed = SDL_GetPerformanceCounter() - frameStart;
+        frameMs.push_back(elapsed * 1000.0 / SDL_GetPerformanceFrequency());
+        return (int)frameMs.size() >= frames;
+    }
+
+    // Print one JSON object on stdout, or stderr when stdout carries exported frames
+    void report(const char* effect, const Kiosk& kiosk, const KioskOptions& options) const {
+        if (!enabled || frameMs.empty()) return;
+        FILE* out = options.exportPath == "-" ? stderr : stdout;
+        std::vector<double> sorted = frameMs;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0;
+        for (double ms : sorted) total += ms;
+        size_t n = sorted.size();
+        double mean = total / n;
+        double p50 = sorted[(n - 1) / 2];
+        double p99 = sorted[std::min(n - 1, (size_t)(n * 0.99))];
+        double nsPerPixel = mean * 1e6 / ((double)kiosk.width * kiosk.height);
+        fprintf(out, "{\"effect\": \"%s\", \"width\": %d, \"height\": %d, \"frames\": %d, "
+                     "\"threads\": %d, \"simd\": \"%s\", \"seed\": %llu, ",
+                effect, kiosk.width, kiosk.height, (int)n, options.threads, simdLevelName(options.simd),
+                (unsigned long long)options.seed);
+        for (const auto& field : fields) {
+            fprintf(out, "\"%s\": \"%s\", ", field.first.c_str(), field.second.c_str());
+        }
+        fprintf(out, "\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"fps\": %.2f, \"ns_per_pixel\": %.3f}\n",
+                mean, p50, p99, 1000.0 * n / total, nsPerPixel);
+        fflush(out);
+    }
+};
@@ -0,0 +1,216 @@
+// kiosk_host.cpp
+// Plays every effect in one process and one window. Effects are initialized once, in the
+// background while the first one is on screen, and stay resident, so switching is instant.
+#define KIOSK_HOST
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "effect.h"
+#include "alliens.cpp"
+#include "matrix.cpp"
+#include "plasma.cpp"
+#include "plasma_stars.cpp"
+#include "starwars.cpp"
+#include "stars.cpp"
+
+const char* const DEFAULT_PLAYLIST = "plasma,stars,plasma_stars,alliens,starwars,matrix";
+const double DEFAULT_DWELL = 60.0; // seconds per effect, for --dwell
+
+enum EntryState { ENTRY_PENDING, ENTRY_READY, ENTRY_FAILED };
+
+struct PlaylistEntry {
+    std::string name;
+    double seconds = DEFAULT_DWELL;
+    std::unique_ptr<Effect> effect;
+    FrameBench bench;              // every effect reports on its own
+    FrameScheduler scheduler;      // and keeps its own animation clock
+    std::atomic<int> state{ENTRY_PENDING};
+    bool resized = false;          // renderer resources exist
+    bool shown = false;
+
+    PlaylistEntry(const KioskOptions& options, const Kiosk& kiosk) : bench(options), scheduler(options, kiosk) {}
+};
+
+std::unique_ptr<Effect> makeEffect(const std::string& name) {
+    if (name == "plasma") return std::unique_ptr<Effect>(new plasma::PlasmaEffect());
+    if (name == "stars") return std::unique_ptr<Effect>(new stars::StarsEffect());
+    if (name == "plasma_stars") return std::unique_ptr<Effect>(new plasma_stars::PlasmaStarsEffect());
+    if (name == "alliens") return std::unique_ptr<Effect>(new alliens::AliensEffect());
+    if (name == "starwars") return std::unique_ptr<Effect>(new starwars::StarWarsEffect());
+    if (name == "matrix") return std::unique_ptr<Effect>(new matrix::MatrixEffect());
+    return nullptr;
+}
+
+// --playlist name[:seconds],... picks the effects and their order, --dwell S the
+// time each one stays on screen unless the playlist gives its own
+bool parsePlaylist(int argc, char* argv[], const KioskOptions& options, const Kiosk& kiosk,
+                   std::vector<std::unique_ptr<PlaylistEntry>>& entries) {
+    std::string playlist = DEFAULT_PLAYLIST;
+    double dwell = DEFAULT_DWELL;
+    for (int i = 1; i < argc; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(argv[i], "--playlist") == 0 && value) {
+            playlist = value;
+            ++i;
+        } else if (strcmp(argv[i], "--dwell") == 0 && value) {
+            dwell = atof(value);
+            ++i;
+            if (dwell <= 0) {
+                SDL_Log("Invalid dwell time '%s'", value);
+                return false;
+            }
+        }
+    }
+    size_t start = 0;
+    while (start <= playlist.size()) {
+        size_t end = playlist.find(',', start);
+        if (end == std::string::npos) end = playlist.size();
+        std::string item = playlist.substr(start, end - start);
+        start = end + 1;
+        if (item.empty()) continue;
+        std::unique_ptr<PlaylistEntry> entry(new PlaylistEntry(options, kiosk));
+        size_t colon = item.find(':');
+        entry->name = item.substr(0, colon);
+        entry->seconds = dwell;
+        if (colon != std::string::npos) {
+            entry->seconds = atof(item.c_str() + colon + 1);
+            if (entry->seconds <= 0) {
+                SDL_Log("Invalid dwell time in playlist entry '%s'", item.c_str());
+                return false;
+            }
+        }
+        entry->effect = makeEffect(entry->name);
+        if (!entry->effect) {
+            SDL_Log("Unknown effect '%s' in playlist", entry->name.c_str());
+            return false;
+        }
+        entries.push_back(std::move(entry));
+    }
+    if (entries.empty()) {
+        SDL_Log("Empty playlist");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    KioskOptions options;
+    if (!parseKioskOptions(argc, argv, options)) {
+        return 1;
+    }
+    Kiosk kiosk;
+    std::vector<std::unique_ptr<PlaylistEntry>> entries;
+    // --verify checks every effect in the playlist without opening a window
+    if (options.verify) {
+        if (!parsePlaylist(argc, argv, options, kiosk, entries)) {
+            return 1;
+        }
+        VerifyRun run(options);
+        for (std::unique_ptr<PlaylistEntry>& entry : entries) {
+            entry->effect->verify(run);
+        }
+        return run.finish() ? 0 : 1;
+    }
+    if (!openKiosk("Plasma Kiosk", options, kiosk)) {
+        return 1;
+    }
+    if (!parsePlaylist(argc, argv, options, kiosk, entries)) {
+        closeKiosk(kiosk);
+        return 1;
+    }
+    ThreadPool pool(options.threads);
+    SDL_Log("Rendering on %d thread(s)", pool.threadCount());
+    FrameTrace trace(options.tracePath, options.budgetMs);
+    // --export writes the whole playlist, each effect for --frames frames, as one sequence
+    FrameExport exporter;
+    if (!exporter.open(options, kiosk.width, kiosk.height, entries.front()->scheduler.hz)) {
+        closeKiosk(kiosk);
+        return 1;
+    }
+
+    // Tables, fields and caches are built in playlist order on one background
+    // thread with a private single-thread pool, so the frame pool stays free
+    std::atomic<bool> stopInit{false};
+    std::thread initThread([&]() {
+        ThreadPool initPool(1);
+        for (std::unique_ptr<PlaylistEntry>& entry : entries) {
+            if (stopInit) break;
+            EffectContext ctx = {argc, argv, options, kiosk, initPool, entry->scheduler, trace, entry->bench, exporter};
+            Uint64 start = SDL_GetPerformanceCounter();
+            bool ok = entry->effect->init(ctx);
+            SDL_Log("%s initialized in %.1f ms", entry->name.c_str(),
+                    (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+            entry->state = ok ? ENTRY_READY : ENTRY_FAILED;
+        }
+    });
+    // Bench runs time each effect alone, without the background work competing
+    if (options.bench) {
+        initThread.join();
+    }
+
+    size_t current = 0;
+    size_t failed = 0;
+    bool running = true;
+    while (running && failed < entries.size()) {
+        PlaylistEntry& entry = *entries[current];
+        EffectContext ctx = {argc, argv, options, kiosk, pool, entry.scheduler, trace, entry.bench, exporter};
+        // Wait for the background init if the playlist got ahead of it
+        while (entry.state == ENTRY_PENDING) {
+            SDL_PumpEvents();
+            SDL_Delay(5);
+        }
+        if (entry.state == ENTRY_READY && !entry.resized) {
+            entry.resized = entry.effect->resize(ctx);
+            if (!entry.resized) entry.state = ENTRY_FAILED;
+        }
+        if (entry.state == ENTRY_FAILED) {
+            if (!entry.shown) ++failed;
+            entry.shown = true;
+            if (options.bench && current + 1 == entries.size()) break;
+            current = (current + 1) % entries.size();
+            continue;
+        }
+        entry.shown = true;
+        entry.scheduler.restart();
+        entry.effect->show(ctx);
+        Uint64 shownAt = SDL_GetPerformanceCounter();
+        bool switchRequested = false;
+        while (!switchRequested) {
+            if (!runEffectFrame(*entry.effect, ctx, switchRequested)) {
+                // A finished bench moves on to the next effect; ESC or a failure ends the show
+                bool benchDone = options.bench && (int)entry.bench.frameMs.size() >= options.frames;
+                running = benchDone;
+                break;
+            }
+            double shownSeconds = (double)(SDL_GetPerformanceCounter() - shownAt) / SDL_GetPerformanceFrequency();
+            if (!options.bench && shownSeconds >= entry.seconds) {
+                switchRequested = true;
+            }
+        }
+        // A bench run gives every effect one turn
+        if (options.bench && current + 1 == entries.size()) break;
+        current = (current + 1) % entries.size();
+    }
+
+    stopInit = true;
+    if (initThread.joinable()) {
+        initThread.join();
+    }
+    bool exported = exporter.close();
+    for (std::unique_ptr<PlaylistEntry>& entry : entries) {
+        EffectContext ctx = {argc, argv, options, kiosk, pool, entry->scheduler, trace, entry->bench, exporter};
+        if (entry->state == ENTRY_READY && entry->resized) {
+            entry->effect->report(ctx);
+            entry->bench.report(entry->effect->name(), kiosk, options);
+            entry->scheduler.report();
+        }
+        entry->effect->release(ctx);
+    }
+    closeKiosk(kiosk);
+    return exported ? 0 : 1;
+}
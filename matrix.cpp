@@ -2,154 +2,264 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <string>
 #include <vector>
+#include "accumulation.h"
+#include "effect.h"
+#include "glyph_atlas.h"
+#include "rng.h"
 
-const int FONT_SIZE = 18;
-const int TRAIL_LENGTH = 18;
+namespace matrix {
+
+const int FONT_SIZE = 18;        // default for --font-size
+const int TRAIL_LENGTH = 18;     // default for --trail
+const int MAX_TRAIL_LENGTH = 256;
+const int COLUMN_GRAIN = 1024;   // columns per parallel update task
 const int SYMBOLS = 96; // printable ASCII
+const float TRAIL_FADE = 60.0f; // alpha of the black fill per 60 Hz frame
 // Download font from https://github.com/powerline/fonts/blob/master/DejaVuSansMono/DejaVu%20Sans%20Mono%20for%20Powerline.ttf
 const char * const FONT_NAME = "DejaVu Sans Mono for Powerline.ttf"; // "DejaVuSansMono.ttf";
 
-// Simple font: use SDL_Rendwget https://github.com/dejavu-fonts/dejavu-fonts/raw/version_2_37/ttf/DejaVuSansMono.ttferDrawText if available, else draw rectangles as glyphs
-char randomChar() {
-    return (char)(32 + rand() % SYMBOLS); // printable ASCII
+int screenWidth = 0;
+int screenHeight = 0;
+
+char randomChar(Rng& rng) {
+    return (char)(32 + rng.below(SYMBOLS)); // printable ASCII
 }
 
-struct Column {
-    int x;
-    float y;
-    float speed;
-    std::vector<char> trail;
+struct MatrixOptions {
+    int fontSize = FONT_SIZE;       // --font-size N: glyph cell size in pixels
+    int trailLength = TRAIL_LENGTH; // --trail N: glyphs per column
 };
 
-int screenWidth = 0;
-int screenHeight = 0;
-
-int main(int argc, char* argv[]) {
-    srand((unsigned int)time(nullptr));
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        SDL_Log("SDL could not initialize! SDL_Error: %s", SDL_GetError());
-        return 1;
+bool parseMatrixOptions(int argc, char* argv[], MatrixOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(argv[i], "--font-size") == 0 && value) {
+            options.fontSize = atoi(value);
+            ++i;
+            if (options.fontSize < 4) {
+                SDL_Log("Invalid font size '%s'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--trail") == 0 && value) {
+            options.trailLength = atoi(value);
+            ++i;
+            if (options.trailLength < 1 || options.trailLength > MAX_TRAIL_LENGTH) {
+                SDL_Log("Invalid trail length '%s', expected 1 to %d", value, MAX_TRAIL_LENGTH);
+                return false;
+            }
+        }
     }
-    if (TTF_Init() < 0) {
-        SDL_Log("SDL_ttf could not initialize! TTF_Error: %s", TTF_GetError());
-        SDL_Quit();
-        return 1;
+    return true;
+}
+
+// All columns in flat arrays. Each trail is a ring buffer: advancing a
+// column writes one glyph at the new head instead of shifting the trail.
+struct MatrixColumns {
+    int count = 0;
+    int trailLength = 0;
+    int cellSize = 0;
+    float speedScale = 1.0f;     // speeds were tuned for 18 px cells
+    std::vector<float> y;        // head position in pixels
+    std::vector<float> speed;    // pixels per 60 Hz frame
+    std::vector<float> due;      // 60 Hz frames since the last glyph was pushed
+    std::vector<int> head;       // ring slot of the newest glyph
+    std::vector<char> trail;     // count * trailLength glyphs
+    std::vector<Rng> rng;        // one stream per column
+};
+
+void respawnColumn(MatrixColumns& columns, int i) {
+    Rng& rng = columns.rng[i];
+    columns.y[i] = -(float)rng.below(columns.trailLength * columns.cellSize);
+    columns.speed[i] = (2.0f + rng.below(100) / 40.0f) * columns.speedScale;
+}
+
+void initColumns(MatrixColumns& columns, int count, const MatrixOptions& options, Uint64 seed) {
+    columns.count = count;
+    columns.trailLength = options.trailLength;
+    columns.cellSize = options.fontSize;
+    columns.speedScale = (float)options.fontSize / FONT_SIZE;
+    columns.y.resize(count);
+    columns.speed.resize(count);
+    columns.due.assign(count, 0.0f);
+    columns.head.assign(count, 0);
+    columns.trail.resize((size_t)count * options.trailLength);
+    columns.rng.clear();
+    Uint64 columnSeed = deriveSeed(seed, "matrix");
+    for (int i = 0; i < count; ++i) {
+        columns.rng.emplace_back(columnSeed, i);
+        Rng& rng = columns.rng[i];
+        columns.y[i] = (float)rng.below(screenHeight);
+        columns.speed[i] = (2.0f + rng.below(100) / 40.0f) * columns.speedScale;
+        for (int j = 0; j < options.trailLength; ++j) {
+            columns.trail[(size_t)i * options.trailLength + j] = randomChar(rng);
+        }
     }
-    TTF_Font* font = TTF_OpenFont(FONT_NAME, FONT_SIZE);
-    if (!font) {
-        SDL_Log("Failed to load font! TTF_Error: %s", TTF_GetError());
-        TTF_Quit();
-        SDL_Quit();
-        return 1;
+}
+
+// Move every column and push one new glyph onto its trail per whole 60 Hz
+// frame, so the glyphs change at the same pace at any refresh rate
+void updateColumns(MatrixColumns& columns, float step, ThreadPool& pool) {
+    const float bottom = (float)(screenHeight + columns.trailLength * columns.cellSize);
+    const int length = columns.trailLength;
+    pool.parallelFor(columns.count, COLUMN_GRAIN, [&](int c0, int c1) {
+        float* y = columns.y.data();
+        const float* speed = columns.speed.data();
+        for (int i = c0; i < c1; ++i) {
+            y[i] += speed[i] * step;
+        }
+        for (int i = c0; i < c1; ++i) {
+            if (y[i] > bottom) respawnColumn(columns, i);
+            columns.due[i] += step;
+            // After a long stall, more than a trail's worth would only overwrite itself
+            int pushes = columns.due[i] < length ? (int)columns.due[i] : length;
+            columns.due[i] -= (int)columns.due[i];
+            for (int k = 0; k < pushes; ++k) {
+                int head = columns.head[i] + 1 == length ? 0 : columns.head[i] + 1;
+                columns.head[i] = head;
+                columns.trail[(size_t)i * length + head] = randomChar(columns.rng[i]);
+            }
+        }
+    });
+}
+
+// Queue the on-screen cells of every column; age j counts back from the head
+void addColumnGlyphs(const MatrixColumns& columns, const GlyphAtlas& atlas, QuadBatch& batch) {
+    const int length = columns.trailLength;
+    const int cell = columns.cellSize;
+    for (int i = 0; i < columns.count; ++i) {
+        int headY = (int)columns.y[i];
+        // Only the ages whose cell overlaps 0..screenHeight, including partly visible ones
+        int first = headY >= screenHeight ? (headY - screenHeight) / cell + 1 : 0;
+        int last = headY > -cell ? (headY + cell - 1) / cell : -1;
+        if (last > length - 1) last = length - 1;
+        const char* trail = &columns.trail[(size_t)i * length];
+        for (int j = first; j <= last; ++j) {
+            int slot = columns.head[i] - j;
+            if (slot < 0) slot += length;
+            SDL_Color color;
+            if (j == 0) {
+                color = {180, 255, 180, 255}; // head
+            } else {
+                color = {0, 255, 70, (Uint8)(255 - j * 200 / length)};
+            }
+            SDL_FRect dst = {(float)(i * cell), (float)(headY - j * cell), (float)cell, (float)cell};
+            addGlyph(batch, atlas, trail[slot], dst, color);
+        }
     }
+}
+
+struct MatrixEffect : Effect {
+    MatrixOptions matrixOptions;
+    bool cpuDecay = false;
+    MatrixColumns columns;
+    TTF_Font* font = nullptr;
+    GlyphAtlas atlas;
+    QuadBatch batch;
+    Accumulator acc;
+    Uint64 updateTicks = 0; // column update time, reported per 10k columns
+    Uint64 updateFrames = 0;
 
-    SDL_DisplayMode displayMode;
-    if (SDL_GetCurrentDisplayMode(0, &displayMode) != 0) {
-        SDL_Log("Could not get display mode! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
+    const char* name() const override { return "matrix"; }
+
+    bool init(EffectContext& ctx) override {
+        if (!parseMatrixOptions(ctx.argc, ctx.argv, matrixOptions) || !parseDecayMode(ctx.argc, ctx.argv, cpuDecay)) {
+            return false;
+        }
+        screenWidth = ctx.kiosk.width;
+        screenHeight = ctx.kiosk.height;
+        initColumns(columns, screenWidth / matrixOptions.fontSize, matrixOptions, ctx.options.seed);
+        ctx.bench.addField("columns", std::to_string(columns.count));
+        ctx.bench.addField("trail", std::to_string(columns.trailLength));
+        ctx.bench.addField("decay", cpuDecay ? "cpu" : "gpu");
+        return true;
     }
-    screenWidth = displayMode.w;
-    screenHeight = displayMode.h;
-
-    SDL_Window* window = SDL_CreateWindow(
-        "Matrix Rain",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        screenWidth,
-        screenHeight,
-        SDL_WINDOW_FULLSCREEN
-    );
-    if (!window) {
-        SDL_Log("Window could not be created! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
+
+    bool resize(EffectContext& ctx) override {
+        SDL_Renderer* renderer = ctx.kiosk.renderer;
+        if (!font) {
+            if (TTF_Init() < 0) {
+                SDL_Log("SDL_ttf could not initialize! TTF_Error: %s", TTF_GetError());
+                return false;
+            }
+            font = TTF_OpenFont(FONT_NAME, matrixOptions.fontSize);
+            if (!font) {
+                SDL_Log("Failed to load font! TTF_Error: %s", TTF_GetError());
+                TTF_Quit();
+                return false;
+            }
+        }
+        // Glyphs are rendered once; every frame is one textured draw call
+        destroyGlyphAtlas(atlas);
+        if (!buildGlyphAtlas(renderer, font, atlas)) {
+            return false;
+        }
+        // Trails fade in an off-screen frame; the backbuffer isn't kept across presents
+        destroyAccumulator(acc);
+        return createAccumulator(renderer, screenWidth, screenHeight, cpuDecay, acc);
     }
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-
-    // Kiosk-like settings
-    SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
-    SDL_SetWindowBordered(window, SDL_FALSE);
-    SDL_SetWindowAlwaysOnTop(window, SDL_TRUE);
-    SDL_SetWindowGrab(window, SDL_TRUE);
-    SDL_ShowCursor(SDL_DISABLE);
-    SDL_RaiseWindow(window);
-    SDL_SetHint(SDL_HINT_GRAB_KEYBOARD, "1");
-    SDL_SetWindowInputFocus(window);
-
-    int cols = screenWidth / FONT_SIZE;
-    std::vector<Column> columns(cols);
-    for (int i = 0; i < cols; ++i) {
-        columns[i].x = i * FONT_SIZE;
-        columns[i].y = rand() % screenHeight;
-        columns[i].speed = 2.0f + (rand() % 100) / 40.0f;
-        columns[i].trail.resize(TRAIL_LENGTH);
-        for (int j = 0; j < TRAIL_LENGTH; ++j) {
-            columns[i].trail[j] = randomChar();
+    void event(EffectContext& ctx, const SDL_Event& e) override {
+        if (e.type == SDL_RENDER_TARGETS_RESET) {
+            clearAccumulator(ctx.kiosk.renderer, acc);
         }
     }
 
-    bool quit = false;
-    SDL_Event e;
-    int t = 0;
-    while (!quit) {
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) {
-                quit = true;
-            }
+    void update(EffectContext& ctx) override {
+        TraceScope scope(ctx.trace, STAGE_COMPUTE);
+        Uint64 start = SDL_GetPerformanceCounter();
+        updateColumns(columns, ctx.scheduler.step(), ctx.pool);
+        updateTicks += SDL_GetPerformanceCounter() - start;
+        ++updateFrames;
+    }
+
+    void render(EffectContext& ctx) override {
+        FrameTrace& trace = ctx.trace;
+        SDL_Renderer* renderer = ctx.kiosk.renderer;
+        // Fade the trails left by previous frames
+        {
+            TraceScope scope(trace, STAGE_COPY);
+            beginAccumulation(renderer, acc, TRAIL_FADE, ctx.scheduler.step(), ctx.options.simd, ctx.pool);
         }
-        // Fade effect: draw a translucent black rectangle over the screen
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 60);
-        SDL_RenderFillRect(renderer, NULL);
         // Draw falling letters
-        for (int i = 0; i < cols; ++i) {
-            Column& col = columns[i];
-            col.y += col.speed;
-            if (col.y > screenHeight + TRAIL_LENGTH * FONT_SIZE) {
-                col.y = -(rand() % (TRAIL_LENGTH * FONT_SIZE));
-                col.speed = 2.0f + (rand() % 100) / 40.0f;
-            }
-            // Update trail
-            for (int j = TRAIL_LENGTH - 1; j > 0; --j) {
-                col.trail[j] = col.trail[j - 1];
-            }
-            col.trail[0] = randomChar();
-            // Draw trail
-            for (int j = 0; j < TRAIL_LENGTH; ++j) {
-                int y = (int)col.y - j * FONT_SIZE;
-                if (y < 0 || y > screenHeight) continue;
-                SDL_Color color;
-                if (j == 0) {
-                    color = {180, 255, 180, 255}; // head
-                } else {
-                    color = {0, 255, 70, (Uint8)(255 - j * (200 / TRAIL_LENGTH))};
-                }
-                char text[2] = {col.trail[j], '\0'};
-                SDL_Surface* textSurface = TTF_RenderText_Blended(font, text, color);
-                if (textSurface) {
-                    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-                    if (textTexture) {
-                        SDL_Rect dstRect = {col.x, y, FONT_SIZE, FONT_SIZE};
-                        SDL_RenderCopy(renderer, textTexture, NULL, &dstRect);
-                        SDL_DestroyTexture(textTexture);
-                    }
-                    SDL_FreeSurface(textSurface);
-                }
-            }
+        {
+            TraceScope scope(trace, STAGE_DRAW);
+            addColumnGlyphs(columns, atlas, batch);
+            drawQuadBatch(renderer, atlas.texture, batch);
+        }
+        {
+            TraceScope scope(trace, STAGE_COPY);
+            endAccumulation(renderer, acc, SDL_BLENDMODE_NONE);
         }
-        SDL_RenderPresent(renderer);
-        SDL_Delay(16);
-        ++t;
     }
-    TTF_CloseFont(font);
-    TTF_Quit();
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
-    return 0;
+
+    void report(EffectContext&) override {
+        if (updateFrames > 0 && columns.count > 0) {
+            double usPerFrame = updateTicks * 1e6 / SDL_GetPerformanceFrequency() / updateFrames;
+            SDL_Log("Column update: %.2f us per 10k columns (%d columns, trail %d)",
+                    usPerFrame * 10000.0 / columns.count, columns.count, columns.trailLength);
+        }
+    }
+
+    void release(EffectContext&) override {
+        destroyAccumulator(acc);
+        destroyGlyphAtlas(atlas);
+        if (font) {
+            TTF_CloseFont(font);
+            TTF_Quit();
+        }
+        font = nullptr;
+    }
+};
+
+} // namespace matrix
+
+#ifndef KIOSK_HOST
+int main(int argc, char* argv[]) {
+    matrix::MatrixEffect effect;
+    return runEffect(effect, "Matrix Rain", argc, argv);
 }
+#endif
 // NOTE: Place a monospaced TTF font (e.g., DejaVuSansMono.ttf) in the project directory for best results.
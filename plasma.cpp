@@ -1,9 +1,20 @@
 #include <SDL2/SDL.h>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "effect.h"
+#include "fixed_point.h"
+#include "frame_pipeline.h"
+#include "indexed.h"
+#include "simd.h"
+#include "verify.h"
+
+namespace plasma {
 
 // Generate a color based on plasma effect
-Uint32 plasmaColor(int x, int y, int t) {
+Uint32 plasmaColor(int x, int y, float t) {
     float value = 
         128.0f + (128.0f * sin(x / 16.0f)) +
         128.0f + (128.0f * sin(y / 8.0f)) +
@@ -16,80 +27,548 @@ Uint32 plasmaColor(int x, int y, int t) {
     return (r << 16) | (g << 8) | b;
 }
 
-int main(int argc, char* argv[]) {
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        SDL_Log("SDL could not initialize! SDL_Error: %s", SDL_GetError());
-        return 1;
-    }
-
-    SDL_DisplayMode displayMode;
-    if (SDL_GetCurrentDisplayMode(0, &displayMode) != 0) {
-        SDL_Log("Could not get display mode! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
-    }
-    int screenWidth = displayMode.w;
-    int screenHeight = displayMode.h;
-
-    SDL_Window* window = SDL_CreateWindow(
-        "Plasma Effect",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        screenWidth,
-        screenHeight,
-        SDL_WINDOW_FULLSCREEN
-    );
-    if (!window) {
-        SDL_Log("Window could not be created! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
-    }
-
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, screenWidth, screenHeight);
-
-    // Enable exclusive fullscreen and disable window decorations for kiosk mode
-    SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
-    SDL_SetWindowBordered(window, SDL_FALSE);
-    SDL_SetWindowAlwaysOnTop(window, SDL_TRUE);
-
-    bool quit = false;
-    SDL_Event e;
-    int t = 0;
-    // Grab input and hide cursor for kiosk mode
-    SDL_SetWindowGrab(window, SDL_TRUE);
-    SDL_ShowCursor(SDL_DISABLE);
-    // Try to grab keyboard focus
-    SDL_RaiseWindow(window);
-    SDL_SetHint(SDL_HINT_GRAB_KEYBOARD, "1");
-    SDL_SetWindowInputFocus(window);
-    // Event loop
-    while (!quit) {
-        // Only scan for ESC key
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) {
-                quit = true;
+// Time enters as (x + y + t) / 16, which repeats every 32 pi frames, and as
+// t * 0.02, which repeats every 100 pi, so the whole plasma repeats every 800 pi
+const double PLASMA_PERIOD = 800 * M_PI;
+
+// The scheduler's time for the plasma kernels
+float plasmaTime(double t) {
+    return wrapAnimationTime(t, PLASMA_PERIOD);
+}
+
+// Table-driven plasma engine. Every term of plasmaColor() is a sine scaled by
+// 128, so each one is stored as an integer in [-128, 128] and the four of them
+// plus 512 give value * 4, which indexes a palette rebuilt once per frame.
+const int PALETTE_SIZE = 1025; // value in [0, 256] at quarter steps
+
+struct PlasmaTables {
+    int width = 0;
+    int height = 0;
+    std::vector<Sint16> colSin;  // 128 * sin(x / 16), per column
+    std::vector<Sint16> rowSin;  // 128 * sin(y / 8), per row
+    std::vector<Sint16> radial;  // 128 * sin(sqrt(x*x + y*y) / 8), per pixel
+    std::vector<Sint16> diag;    // 128 * sin((x + y + t) / 16), indexed by x + y
+    std::vector<Uint32> palette; // RGB888 color for value = index / 4
+};
+
+Sint16 scaledSin(double a) {
+    return (Sint16)lround(128.0 * sin(a));
+}
+
+// Build the static terms once for the display size
+void buildPlasmaTables(PlasmaTables& tables, int width, int height) {
+    tables.width = width;
+    tables.height = height;
+    tables.colSin.resize(width);
+    tables.rowSin.resize(height);
+    tables.radial.resize((size_t)width * height);
+    tables.diag.resize(width + height - 1);
+    tables.palette.resize(PALETTE_SIZE);
+    for (int x = 0; x < width; ++x) {
+        tables.colSin[x] = scaledSin(x / 16.0);
+    }
+    for (int y = 0; y < height; ++y) {
+        tables.rowSin[y] = scaledSin(y / 8.0);
+        Sint16* row = &tables.radial[(size_t)y * width];
+        for (int x = 0; x < width; ++x) {
+            row[x] = scaledSin(sqrt((double)x * x + (double)y * y) / 8.0);
+        }
+    }
+}
+
+// Rebuild the time-dependent diagonal term and palette for frame t
+void updatePlasmaTables(PlasmaTables& tables, float t) {
+    for (size_t i = 0; i < tables.diag.size(); ++i) {
+        tables.diag[i] = scaledSin((i + t) / 16.0);
+    }
+    for (int i = 0; i < PALETTE_SIZE; ++i) {
+        float value = i / 4.0f;
+        Uint8 r = (Uint8)(128 + 127 * sin(0.02f * value + t * 0.02f));
+        Uint8 g = (Uint8)(128 + 127 * sin(0.02f * value + 2 + t * 0.02f));
+        Uint8 b = (Uint8)(128 + 127 * sin(0.02f * value + 4 + t * 0.02f));
+        tables.palette[i] = (r << 16) | (g << 8) | b;
+    }
+}
+
+// Fixed-point variants of the two functions above for --engine fixed: the same
+// tables filled from fixed_point.h angles, so the row kernels are shared and a
+// frame runs without floating point apart from one conversion of t per term.
+// Terms stay within 1 of scaledSin() and palette channels within 1 of the
+// float ones, which moves a pixel by at most 2 of 255 per channel (measured
+// over 2000 frames at 1920x1080, see README).
+const Uint64 PLASMA_X_STEP = (Uint64)llround(FIX_RADIAN / 16.0 * 65536.0);      // x / 16, Q16 angle
+const Uint64 PLASMA_Y_STEP = (Uint64)llround(FIX_RADIAN / 8.0 * 65536.0);       // y / 8
+const Uint64 PLASMA_R_STEP = (Uint64)llround(FIX_RADIAN / 8.0 / 256.0 * 65536.0);  // r / 8, r in Q8
+const Uint64 PLASMA_VALUE_STEP = (Uint64)llround(FIX_RADIAN * 0.005 * 65536.0);  // 0.02 * i / 4
+
+void buildPlasmaTablesFixed(PlasmaTables& tables, int width, int height) {
+    tables.width = width;
+    tables.height = height;
+    tables.colSin.resize(width);
+    tables.rowSin.resize(height);
+    tables.radial.resize((size_t)width * height);
+    tables.diag.resize(width + height - 1);
+    tables.palette.resize(PALETTE_SIZE);
+    for (int x = 0; x < width; ++x) {
+        tables.colSin[x] = (Sint16)fixSinScaled((Uint32)((x * PLASMA_X_STEP) >> 16), 128);
+    }
+    for (int y = 0; y < height; ++y) {
+        tables.rowSin[y] = (Sint16)fixSinScaled((Uint32)((y * PLASMA_Y_STEP) >> 16), 128);
+        Sint16* row = &tables.radial[(size_t)y * width];
+        for (int x = 0; x < width; ++x) {
+            Uint64 rQ8 = isqrt64(((Uint64)x * x + (Uint64)y * y) << 16);
+            row[x] = (Sint16)fixSinScaled((Uint32)((rQ8 * PLASMA_R_STEP) >> 16), 128);
+        }
+    }
+}
+
+void updatePlasmaTablesFixed(PlasmaTables& tables, float t) {
+    Uint32 diagAngle = fixAngleOf(t / 16.0);
+    for (size_t i = 0; i < tables.diag.size(); ++i) {
+        tables.diag[i] = (Sint16)fixSinScaled((Uint32)((i * PLASMA_X_STEP) >> 16) + diagAngle, 128);
+    }
+    Uint32 red = fixAngleOf(t * 0.02f);
+    Uint32 green = red + fixAngleOf(2.0);
+    Uint32 blue = red + fixAngleOf(4.0);
+    for (int i = 0; i < PALETTE_SIZE; ++i) {
+        Uint32 value = (Uint32)((i * PLASMA_VALUE_STEP) >> 16);
+        Uint32 r = 128 + ((127 * fixSin(value + red)) >> 14);
+        Uint32 g = 128 + ((127 * fixSin(value + green)) >> 14);
+        Uint32 b = 128 + ((127 * fixSin(value + blue)) >> 14);
+        tables.palette[i] = (r << 16) | (g << 8) | b;
+    }
+}
+
+// Scalar reference for the vector row kernels below; starts at column x0
+void renderPlasmaRowScalar(const PlasmaTables& tables, int y, int x0, Uint32* row) {
+    const Sint16* col = tables.colSin.data();
+    const Sint16* radial = &tables.radial[(size_t)y * tables.width];
+    const Sint16* diag = &tables.diag[y];
+    const Uint32* palette = tables.palette.data();
+    int base = 512 + tables.rowSin[y];
+    for (int x = x0; x < tables.width; ++x) {
+        row[x] = palette[base + col[x] + diag[x] + radial[x]];
+    }
+}
+
+#if defined(SIMD_X86)
+// 8 pixels per iteration: vector index sums, scalar palette loads
+SIMD_TARGET_SSE2 void renderPlasmaRowSse2(const PlasmaTables& tables, int y, Uint32* row) {
+    const Sint16* col = tables.colSin.data();
+    const Sint16* radial = &tables.radial[(size_t)y * tables.width];
+    const Sint16* diag = &tables.diag[y];
+    const Uint32* palette = tables.palette.data();
+    __m128i base = _mm_set1_epi16((short)(512 + tables.rowSin[y]));
+    alignas(16) Uint16 index[8];
+    int x = 0;
+    for (; x + 8 <= tables.width; x += 8) {
+        __m128i sum = _mm_add_epi16(base, _mm_loadu_si128((const __m128i*)(col + x)));
+        sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i*)(diag + x)));
+        sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i*)(radial + x)));
+        _mm_store_si128((__m128i*)index, sum);
+        for (int i = 0; i < 8; ++i) {
+            row[x + i] = palette[index[i]];
+        }
+    }
+    renderPlasmaRowScalar(tables, y, x, row);
+}
+
+// 16 pixels per iteration: vector index sums and two palette gathers
+SIMD_TARGET_AVX2 void renderPlasmaRowAvx2(const PlasmaTables& tables, int y, Uint32* row) {
+    const Sint16* col = tables.colSin.data();
+    const Sint16* radial = &tables.radial[(size_t)y * tables.width];
+    const Sint16* diag = &tables.diag[y];
+    const int* palette = (const int*)tables.palette.data();
+    __m256i base = _mm256_set1_epi16((short)(512 + tables.rowSin[y]));
+    int x = 0;
+    for (; x + 16 <= tables.width; x += 16) {
+        __m256i sum = _mm256_add_epi16(base, _mm256_loadu_si256((const __m256i*)(col + x)));
+        sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*)(diag + x)));
+        sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*)(radial + x)));
+        __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(sum));
+        __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(sum, 1));
+        _mm256_storeu_si256((__m256i*)(row + x), _mm256_i32gather_epi32(palette, lo, 4));
+        _mm256_storeu_si256((__m256i*)(row + x + 8), _mm256_i32gather_epi32(palette, hi, 4));
+    }
+    renderPlasmaRowScalar(tables, y, x, row);
+}
+#elif defined(SIMD_ARM)
+// 8 pixels per iteration: vector index sums, scalar palette loads
+void renderPlasmaRowNeon(const PlasmaTables& tables, int y, Uint32* row) {
+    const Sint16* col = tables.colSin.data();
+    const Sint16* radial = &tables.radial[(size_t)y * tables.width];
+    const Sint16* diag = &tables.diag[y];
+    const Uint32* palette = tables.palette.data();
+    int16x8_t base = vdupq_n_s16((int16_t)(512 + tables.rowSin[y]));
+    Uint16 index[8];
+    int x = 0;
+    for (; x + 8 <= tables.width; x += 8) {
+        int16x8_t sum = vaddq_s16(base, vld1q_s16(col + x));
+        sum = vaddq_s16(sum, vld1q_s16(diag + x));
+        sum = vaddq_s16(sum, vld1q_s16(radial + x));
+        vst1q_u16(index, vreinterpretq_u16_s16(sum));
+        for (int i = 0; i < 8; ++i) {
+            row[x + i] = palette[index[i]];
+        }
+    }
+    renderPlasmaRowScalar(tables, y, x, row);
+}
+#endif
+
+void renderPlasmaRow(SimdLevel level, const PlasmaTables& tables, int y, Uint32* row) {
+    switch (level) {
+#if defined(SIMD_X86)
+        case SIMD_AVX2: renderPlasmaRowAvx2(tables, y, row); return;
+        case SIMD_SSE2: renderPlasmaRowSse2(tables, y, row); return;
+#elif defined(SIMD_ARM)
+        case SIMD_NEON: renderPlasmaRowNeon(tables, y, row); return;
+#endif
+        default: renderPlasmaRowScalar(tables, y, 0, row); return;
+    }
+}
+
+// Indexed variant: the index is value = sum / 4 (the palette entry at a whole
+// value), clamped to 255, so a row writes one byte per pixel.
+void renderPlasmaIndexRowScalar(const PlasmaTables& tables, int y, int x0, Uint8* row) {
+    const Sint16* col = tables.colSin.data();
+    const Sint16* radial = &tables.radial[(size_t)y * tables.width];
+    const Sint16* diag = &tables.diag[y];
+    int base = 512 + tables.rowSin[y];
+    for (int x = x0; x < tables.width; ++x) {
+        int value = (base + col[x] + diag[x] + radial[x]) >> 2;
+        row[x] = (Uint8)(value < 255 ? value : 255);
+    }
+}
+
+#if defined(SIMD_X86)
+// 8 pixels per iteration; packus does the clamp to 255
+SIMD_TARGET_SSE2 void renderPlasmaIndexRowSse2(const PlasmaTables& tables, int y, Uint8* row) {
+    const Sint16* col = tables.colSin.data();
+    const Sint16* radial = &tables.radial[(size_t)y * tables.width];
+    const Sint16* diag = &tables.diag[y];
+    __m128i base = _mm_set1_epi16((short)(512 + tables.rowSin[y]));
+    int x = 0;
+    for (; x + 8 <= tables.width; x += 8) {
+        __m128i sum = _mm_add_epi16(base, _mm_loadu_si128((const __m128i*)(col + x)));
+        sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i*)(diag + x)));
+        sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i*)(radial + x)));
+        sum = _mm_srli_epi16(sum, 2);
+        _mm_storel_epi64((__m128i*)(row + x), _mm_packus_epi16(sum, sum));
+    }
+    renderPlasmaIndexRowScalar(tables, y, x, row);
+}
+
+// 16 pixels per iteration
+SIMD_TARGET_AVX2 void renderPlasmaIndexRowAvx2(const PlasmaTables& tables, int y, Uint8* row) {
+    const Sint16* col = tables.colSin.data();
+    const Sint16* radial = &tables.radial[(size_t)y * tables.width];
+    const Sint16* diag = &tables.diag[y];
+    __m256i base = _mm256_set1_epi16((short)(512 + tables.rowSin[y]));
+    int x = 0;
+    for (; x + 16 <= tables.width; x += 16) {
+        __m256i sum = _mm256_add_epi16(base, _mm256_loadu_si256((const __m256i*)(col + x)));
+        sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*)(diag + x)));
+        sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*)(radial + x)));
+        sum = _mm256_srli_epi16(sum, 2);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        _mm_storeu_si128((__m128i*)(row + x), bytes);
+    }
+    renderPlasmaIndexRowScalar(tables, y, x, row);
+}
+#elif defined(SIMD_ARM)
+// 8 pixels per iteration; vqmovun does the clamp to 255
+void renderPlasmaIndexRowNeon(const PlasmaTables& tables, int y, Uint8* row) {
+    const Sint16* col = tables.colSin.data();
+    const Sint16* radial = &tables.radial[(size_t)y * tables.width];
+    const Sint16* diag = &tables.diag[y];
+    int16x8_t base = vdupq_n_s16((int16_t)(512 + tables.rowSin[y]));
+    int x = 0;
+    for (; x + 8 <= tables.width; x += 8) {
+        int16x8_t sum = vaddq_s16(base, vld1q_s16(col + x));
+        sum = vaddq_s16(sum, vld1q_s16(diag + x));
+        sum = vaddq_s16(sum, vld1q_s16(radial + x));
+        vst1_u8(row + x, vqmovun_s16(vshrq_n_s16(sum, 2)));
+    }
+    renderPlasmaIndexRowScalar(tables, y, x, row);
+}
+#endif
+
+void renderPlasmaIndexRow(SimdLevel level, const PlasmaTables& tables, int y, Uint8* row) {
+    switch (level) {
+#if defined(SIMD_X86)
+        case SIMD_AVX2: renderPlasmaIndexRowAvx2(tables, y, row); return;
+        case SIMD_SSE2: renderPlasmaIndexRowSse2(tables, y, row); return;
+#elif defined(SIMD_ARM)
+        case SIMD_NEON: renderPlasmaIndexRowNeon(tables, y, row); return;
+#endif
+        default: renderPlasmaIndexRowScalar(tables, y, 0, row); return;
+    }
+}
+
+// --verify tolerances against plasmaColor(), with headroom over the measured
+// errors: table terms are rounded to integers and the palette to quarter steps
+// of value (2 levels, for the fixed tables too), and indexed frames keep every
+// 4th palette entry (4 levels)
+const VerifyTolerance PLASMA_TABLE_TOLERANCE = {3, 50.0};
+const VerifyTolerance PLASMA_FIXED_TOLERANCE = {3, 50.0};
+const VerifyTolerance PLASMA_INDEXED_TOLERANCE = {6, 44.0};
+
+struct PlasmaEffect : Effect {
+    bool useTables = true;
+    bool fixedPoint = false;  // --engine fixed: tables built and updated without floating point
+    bool indexed = false;
+    SimdLevel simd = SIMD_SCALAR;
+    int screenWidth = 0;
+    int screenHeight = 0;
+    PlasmaTables tables;
+    IndexedFrame frame;
+    SDL_Texture* texture = nullptr;
+    int pipelineDepth = 0;
+    FramePipeline pipeline;
+    LatencyStats latency;
+    Uint64 shadeStart = 0;  // when shading of the frame being drawn started, 0 if it is a reused one
+
+    const char* name() const override { return "plasma"; }
+
+    bool init(EffectContext& ctx) override {
+        // --engine table (default), formula to compare against plasmaColor(), or fixed for integer-only tables
+        for (int i = 1; i < ctx.argc; ++i) {
+            if (strcmp(ctx.argv[i], "--engine") == 0 && i + 1 < ctx.argc) {
+                const char* engine = ctx.argv[++i];
+                useTables = strcmp(engine, "formula") != 0;
+                fixedPoint = strcmp(engine, "fixed") == 0;
+                if (useTables && !fixedPoint && strcmp(engine, "table") != 0) {
+                    SDL_Log("Unknown engine '%s', expected 'table', 'formula' or 'fixed'", engine);
+                    return false;
+                }
             }
         }
-        void* pixels;
-        int pitch;
-        SDL_LockTexture(texture, NULL, &pixels, &pitch);
-        Uint32* buf = (Uint32*)pixels;
-        for (int y = 0; y < screenHeight; ++y) {
-            for (int x = 0; x < screenWidth; ++x) {
-                buf[y * (pitch / 4) + x] = plasmaColor(x, y, t);
+        if (!parsePipelineDepth(ctx.argc, ctx.argv, pipelineDepth)) {
+            return false;
+        }
+        indexed = ctx.options.indexed;
+        simd = ctx.options.simd;
+        if (indexed && !useTables) {
+            SDL_Log("--color indexed needs the table or fixed engine");
+            return false;
+        }
+        screenWidth = ctx.kiosk.width;
+        screenHeight = ctx.kiosk.height;
+        if (fixedPoint) {
+            buildPlasmaTablesFixed(tables, screenWidth, screenHeight);
+            SDL_Log("Plasma engine: fixed, %s row kernel, %s", simdLevelName(simd), indexed ? "indexed" : "rgb");
+        } else if (useTables) {
+            buildPlasmaTables(tables, screenWidth, screenHeight);
+            SDL_Log("Plasma engine: table, %s row kernel, %s", simdLevelName(simd), indexed ? "indexed" : "rgb");
+        } else {
+            SDL_Log("Plasma engine: formula");
+        }
+        if (indexed) {
+            frame.resize(screenWidth, screenHeight);
+        }
+        ctx.bench.addField("engine", fixedPoint ? "fixed" : useTables ? "table" : "formula");
+        ctx.bench.addField("color", indexed ? "indexed" : "rgb");
+        ctx.bench.addField("pipeline", std::to_string(pipelineDepth > 1 ? pipelineDepth : 0));
+        return true;
+    }
+
+    bool resize(EffectContext& ctx) override {
+        if (texture) SDL_DestroyTexture(texture);
+        texture = SDL_CreateTexture(ctx.kiosk.renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING,
+                                    screenWidth, screenHeight);
+        if (!texture) {
+            SDL_Log("Texture could not be created! SDL_Error: %s", SDL_GetError());
+            return false;
+        }
+        if (pipelineDepth > 1 && !pipeline.running()) {
+            pipeline.start(pipelineDepth, ctx.options.threads, [this](StagedFrame& staged, ThreadPool& pool) {
+                shadeStaged(staged, pool);
+            });
+        }
+        return true;
+    }
+
+    void updateTables(float t) {
+        if (fixedPoint) {
+            updatePlasmaTablesFixed(tables, t);
+        } else {
+            updatePlasmaTables(tables, t);
+        }
+    }
+
+    // Palette indices of the whole frame, and the palette they refer to
+    void shadeIndexed(float t, IndexedFrame& out, ThreadPool& pool) {
+        updateTables(t);
+        for (int i = 0; i < INDEXED_COLORS; ++i) {
+            out.palette[i] = tables.palette[4 * i];
+        }
+        pool.parallelFor(screenHeight, 8, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                renderPlasmaIndexRow(simd, tables, y, out.row(y));
             }
+        });
+    }
+
+    // RGB888 rows, pitchPixels apart
+    void shadeRgb(float t, Uint32* buf, int pitchPixels, ThreadPool& pool) {
+        if (useTables) {
+            updateTables(t);
         }
-        SDL_UnlockTexture(texture);
-        SDL_RenderClear(renderer);
-        SDL_RenderCopy(renderer, texture, NULL, NULL);
-        SDL_RenderPresent(renderer);
-        SDL_Delay(16);
-        ++t;
+        // Workers take bands of rows; parallelFor returns before the texture is unlocked
+        pool.parallelFor(screenHeight, 8, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                if (useTables) {
+                    renderPlasmaRow(simd, tables, y, buf + y * pitchPixels);
+                } else {
+                    for (int x = 0; x < screenWidth; ++x) {
+                        buf[y * pitchPixels + x] = plasmaColor(x, y, t);
+                    }
+                }
+            }
+        });
     }
-    SDL_DestroyTexture(texture);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
-    return 0;
+
+    // Producer side of --pipeline: only the producer touches the tables while it runs
+    void shadeStaged(StagedFrame& staged, ThreadPool& pool) {
+        if (indexed) {
+            if (staged.indexed.width != screenWidth) staged.indexed.resize(screenWidth, screenHeight);
+            shadeIndexed(staged.t, staged.indexed, pool);
+        } else {
+            staged.width = screenWidth;
+            staged.height = screenHeight;
+            staged.pixels.resize((size_t)screenWidth * screenHeight);
+            shadeRgb(staged.t, staged.pixels.data(), screenWidth, pool);
+        }
+    }
+
+    void render(EffectContext& ctx) override {
+        FrameTrace& trace = ctx.trace;
+        ThreadPool& pool = ctx.pool;
+        SDL_Renderer* renderer = ctx.kiosk.renderer;
+        shadeStart = 0;
+        if (pipeline.running()) {
+            // Shaded ahead by the producer (see FramePipeline::fill)
+            StagedFrame* staged;
+            {
+                TraceScope scope(trace, STAGE_COMPUTE);
+                pipeline.fill([&](int ahead) { return plasmaTime(ctx.scheduler.frameTimeAhead(ahead)); });
+                staged = &pipeline.acquire();
+            }
+            TraceScope scope(trace, STAGE_UPLOAD);
+            void* pixels;
+            int pitch;
+            SDL_LockTexture(texture, NULL, &pixels, &pitch);
+            pool.parallelFor(screenHeight, 8, [&](int y0, int y1) {
+                uploadStagedRows(*staged, simd, indexed, y0, y1, (Uint32*)pixels, pitch / 4);
+            });
+            SDL_UnlockTexture(texture);
+            shadeStart = staged->shadeStart;
+            pipeline.release();
+        } else if (!ctx.scheduler.degraded) {
+            // Under load keep showing the previous frame's texture
+            shadeStart = SDL_GetPerformanceCounter();
+            float t = plasmaTime(ctx.scheduler.frameTime());
+            if (indexed) {
+                // Before the lock (see IndexedFrame)
+                TraceScope scope(trace, STAGE_COMPUTE);
+                shadeIndexed(t, frame, pool);
+            }
+            void* pixels;
+            int pitch;
+            {
+                TraceScope scope(trace, STAGE_UPLOAD);
+                SDL_LockTexture(texture, NULL, &pixels, &pitch);
+            }
+            if (indexed) {
+                TraceScope scope(trace, STAGE_UPLOAD);
+                Uint32* buf = (Uint32*)pixels;
+                pool.parallelFor(screenHeight, 8, [&](int y0, int y1) {
+                    for (int y = y0; y < y1; ++y) {
+                        expandIndexedRow(simd, frame.row(y), frame.palette, screenWidth, buf + y * (pitch / 4));
+                    }
+                });
+            } else {
+                TraceScope scope(trace, STAGE_COMPUTE);
+                shadeRgb(t, (Uint32*)pixels, pitch / 4, pool);
+            }
+            {
+                TraceScope scope(trace, STAGE_UPLOAD);
+                SDL_UnlockTexture(texture);
+            }
+        }
+        {
+            TraceScope scope(trace, STAGE_COPY);
+            SDL_RenderClear(renderer);
+            SDL_RenderCopy(renderer, texture, NULL, NULL);
+        }
+    }
+
+    bool endFrame(EffectContext&) override {
+        if (shadeStart) latency.add(shadeStart);
+        return true;
+    }
+
+    void report(EffectContext& ctx) override {
+        latency.report(ctx.bench);
+    }
+
+    // Every table kernel, RGB and indexed, with float and fixed-point tables, through
+    // the same shading calls as the frame loop
+    void verify(VerifyRun& run) override {
+        for (const auto& size : run.sizes) {
+            screenWidth = size.first;
+            screenHeight = size.second;
+            run.reference("plasma", screenWidth, screenHeight, (size_t)screenWidth * screenHeight,
+                          [&](float t, Uint32* out) {
+                run.pool.parallelFor(screenHeight, 8, [&](int y0, int y1) {
+                    for (int y = y0; y < y1; ++y) {
+                        for (int x = 0; x < screenWidth; ++x) {
+                            out[(size_t)y * screenWidth + x] = plasmaColor(x, y, t);
+                        }
+                    }
+                });
+            });
+            frame.resize(screenWidth, screenHeight);
+            for (bool fixed : {false, true}) {
+                fixedPoint = fixed;
+                if (fixed) {
+                    buildPlasmaTablesFixed(tables, screenWidth, screenHeight);
+                } else {
+                    buildPlasmaTables(tables, screenWidth, screenHeight);
+                }
+                for (SimdLevel level : verifySimdLevels()) {
+                    simd = level;
+                    std::string name = std::string(fixed ? "fixed/" : "table/") + simdLevelName(level);
+                    run.kernel(name, fixed ? PLASMA_FIXED_TOLERANCE : PLASMA_TABLE_TOLERANCE, [&](float t, Uint32* out) {
+                        shadeRgb(t, out, screenWidth, run.pool);
+                    });
+                    run.kernel(name + "/indexed", PLASMA_INDEXED_TOLERANCE, [&](float t, Uint32* out) {
+                        shadeIndexed(t, frame, run.pool);
+                        run.pool.parallelFor(screenHeight, 8, [&](int y0, int y1) {
+                            for (int y = y0; y < y1; ++y) {
+                                expandIndexedRow(simd, frame.row(y), frame.palette, screenWidth,
+                                                 out + (size_t)y * screenWidth);
+                            }
+                        });
+                    });
+                }
+            }
+        }
+        verifyAnimationClock(run, "plasma", "clock", PLASMA_PERIOD);
+    }
+
+    void release(EffectContext&) override {
+        pipeline.stop();
+        if (texture) SDL_DestroyTexture(texture);
+        texture = nullptr;
+    }
+};
+
+} // namespace plasma
+
+#ifndef KIOSK_HOST
+int main(int argc, char* argv[]) {
+    plasma::PlasmaEffect effect;
+    return runEffect(effect, "Plasma Effect", argc, argv);
 }
+#endif
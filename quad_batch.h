@@ -0,0 +1,69 @@
+// quad_batch.h
+// Quads collected over a frame and submitted with one SDL_RenderGeometry call
+#pragma once
+#include <SDL2/SDL.h>
+#include <cmath>
+#include <vector>
+
+struct QuadBatch {
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;  // two triangles per quad; only grows, shared by every frame
+};
+
+// uv is in normalized texture coordinates; color tints the texture. Writes the
+// four vertices in place, so workers can fill their own quads of a presized batch.
+inline void setQuad(SDL_Vertex* quad, const SDL_FRect& dst, const SDL_FRect& uv, SDL_Color color) {
+    quad[0] = {{dst.x, dst.y}, color, {uv.x, uv.y}};
+    quad[1] = {{dst.x + dst.w, dst.y}, color, {uv.x + uv.w, uv.y}};
+    quad[2] = {{dst.x + dst.w, dst.y + dst.h}, color, {uv.x + uv.w, uv.y + uv.h}};
+    quad[3] = {{dst.x, dst.y + dst.h}, color, {uv.x, uv.y + uv.h}};
+}
+
+inline void addQuad(QuadBatch& batch, const SDL_FRect& dst, const SDL_FRect& uv, SDL_Color color) {
+    batch.vertices.resize(batch.vertices.size() + 4);
+    setQuad(&batch.vertices[batch.vertices.size() - 4], dst, uv, color);
+}
+
+// The four vertices of a line `width` pixels wide from `from` to `to`, shaded from
+// fromColor to toColor, for untextured batches. Written in place like setQuad.
+// Lines shorter than a pixel are extended back to one pixel so they still
+// cover something.
+inline void setLineQuad(SDL_Vertex* quad, SDL_FPoint from, SDL_FPoint to, float width, SDL_Color fromColor,
+                        SDL_Color toColor) {
+    float dx = to.x - from.x;
+    float dy = to.y - from.y;
+    float length = sqrtf(dx * dx + dy * dy);
+    if (length > 1e-4f) {
+        dx /= length;
+        dy /= length;
+    } else {
+        dx = 1.0f;
+        dy = 0.0f;
+    }
+    if (length < 1.0f) {
+        from.x = to.x - dx;
+        from.y = to.y - dy;
+    }
+    float nx = -dy * 0.5f * width;
+    float ny = dx * 0.5f * width;
+    quad[0] = {{from.x + nx, from.y + ny}, fromColor, {0, 0}};
+    quad[1] = {{to.x + nx, to.y + ny}, toColor, {0, 0}};
+    quad[2] = {{to.x - nx, to.y - ny}, toColor, {0, 0}};
+    quad[3] = {{from.x - nx, from.y - ny}, fromColor, {0, 0}};
+}
+
+// Draw and empty the batch; without a texture the vertex colors are blended
+// with the renderer's draw blend mode
+inline void drawQuadBatch(SDL_Renderer* renderer, SDL_Texture* texture, QuadBatch& batch) {
+    int quads = (int)batch.vertices.size() / 4;
+    for (int q = (int)batch.indices.size() / 6; q < quads; ++q) {
+        int v = q * 4;
+        int quad[6] = {v, v + 1, v + 2, v, v + 2, v + 3};
+        batch.indices.insert(batch.indices.end(), quad, quad + 6);
+    }
+    if (quads > 0) {
+        SDL_RenderGeometry(renderer, texture, batch.vertices.data(), (int)batch.vertices.size(),
+                           batch.indices.data(), quads * 6);
+    }
+    batch.vertices.clear();
+}
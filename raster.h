@@ -0,0 +1,68 @@
+// raster.h
+// Filled shapes as one horizontal span per scanline, drawn with SDL_RenderFillRects or written into a pixel buffer
+#pragma once
+#include <SDL2/SDL.h>
+#include <cmath>
+#include <vector>
+
+// Rows dy0..dy1 (relative to cy) of the disc of pixels with dx*dx + dy*dy <= radius*radius,
+// the same set the per-pixel loops covered, as one span [x0, x1] per row
+template <typename SpanFn>
+inline void forEachDiscSpan(int cx, int cy, float radius, int dy0, int dy1, SpanFn span) {
+    if (radius < 0) return;
+    float r2 = radius * radius;
+    int extent = (int)radius;
+    if (dy0 < -extent) dy0 = -extent;
+    if (dy1 > extent) dy1 = extent;
+    for (int dy = dy0; dy <= dy1; ++dy) {
+        float rest = r2 - (float)(dy * dy);
+        int half = (int)sqrtf(rest > 0 ? rest : 0);
+        // sqrtf may round either way; settle on the exact integer bound
+        while ((float)((half + 1) * (half + 1) + dy * dy) <= r2) ++half;
+        while (half > 0 && (float)(half * half + dy * dy) > r2) --half;
+        span(cy + dy, cx - half, cx + half);
+    }
+}
+
+template <typename SpanFn>
+inline void forEachDiscSpan(int cx, int cy, float radius, SpanFn span) {
+    forEachDiscSpan(cx, cy, radius, -(int)radius, (int)radius, span);
+}
+
+// Spans of one color, collected and drawn with a single SDL_RenderFillRects call
+struct SpanBatch {
+    std::vector<SDL_Rect> rects;
+};
+
+inline void addDiscSpans(SpanBatch& batch, int cx, int cy, float radius) {
+    forEachDiscSpan(cx, cy, radius, [&](int y, int x0, int x1) {
+        batch.rects.push_back({x0, y, x1 - x0 + 1, 1});
+    });
+}
+
+// Only the rows of the disc between dy0 and dy1, e.g. a band across a sphere
+inline void addDiscBandSpans(SpanBatch& batch, int cx, int cy, float radius, int dy0, int dy1) {
+    forEachDiscSpan(cx, cy, radius, dy0, dy1, [&](int y, int x0, int x1) {
+        batch.rects.push_back({x0, y, x1 - x0 + 1, 1});
+    });
+}
+
+// Fill with the current draw color and empty the batch
+inline void drawSpans(SDL_Renderer* renderer, SpanBatch& batch) {
+    if (!batch.rects.empty()) {
+        SDL_RenderFillRects(renderer, batch.rects.data(), (int)batch.rects.size());
+    }
+    batch.rects.clear();
+}
+
+// Write a disc straight into a 32-bit buffer, clipped to width x height
+inline void fillDiscPixels(Uint32* pixels, int pitchPixels, int width, int height, int cx, int cy, float radius,
+                           Uint32 color) {
+    forEachDiscSpan(cx, cy, radius, [&](int y, int x0, int x1) {
+        if (y < 0 || y >= height) return;
+        if (x0 < 0) x0 = 0;
+        if (x1 >= width) x1 = width - 1;
+        Uint32* row = pixels + (size_t)y * pitchPixels;
+        for (int x = x0; x <= x1; ++x) row[x] = color;
+    });
+}
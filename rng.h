@@ -0,0 +1,65 @@
+// rng.h
+// Seedable xoshiro128** generator with independent streams, so parallel updates never share state
+#pragma once
+#include <SDL2/SDL.h>
+
+// SplitMix64 step: spreads a seed over the whole generator state
+inline Uint64 splitMix64(Uint64& state) {
+    Uint64 z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Separate seed per subsystem ("stars", "aliens", ...) so their streams never coincide
+inline Uint64 deriveSeed(Uint64 seed, const char* name) {
+    Uint64 hash = 0xCBF29CE484222325ull; // FNV-1a
+    for (const char* c = name; *c; ++c) {
+        hash = (hash ^ (Uint8)*c) * 0x100000001B3ull;
+    }
+    Uint64 state = seed ^ hash;
+    return splitMix64(state);
+}
+
+// One stream per seed and stream index: use the thread, chunk or column
+// index as the stream so the result doesn't depend on which thread ran it.
+struct Rng {
+    Uint32 s[4];
+
+    explicit Rng(Uint64 seed = 1, Uint64 stream = 0) {
+        Uint64 state = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        Uint64 a = splitMix64(state);
+        Uint64 b = splitMix64(state);
+        s[0] = (Uint32)a;
+        s[1] = (Uint32)(a >> 32);
+        s[2] = (Uint32)b;
+        s[3] = (Uint32)(b >> 32);
+    }
+
+    Uint32 next() {
+        Uint32 result = rotate(s[1] * 5, 7) * 9;
+        Uint32 t = s[1] << 9;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotate(s[3], 11);
+        return result;
+    }
+
+    // Uniform in [0, n) by multiply and shift instead of a division
+    Uint32 below(Uint32 n) {
+        return (Uint32)(((Uint64)next() * n) >> 32);
+    }
+
+    // Uniform in [0, 1)
+    float uniform() {
+        return (float)(next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    static Uint32 rotate(Uint32 x, int k) {
+        return (x << k) | (x >> (32 - k));
+    }
+};
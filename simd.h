@@ -0,0 +1,201 @@
+// simd.h
+// Runtime instruction-set selection and small vector helpers shared by the pixel kernels
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_ARM 1
+#endif
+
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_NEON
+};
+
+inline const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_SSE2: return "sse2";
+        case SIMD_AVX2: return "avx2";
+        case SIMD_NEON: return "neon";
+        default: return "scalar";
+    }
+}
+
+// Best instruction set this binary was built for that the running CPU supports
+inline SimdLevel detectSimdLevel() {
+#if defined(SIMD_X86)
+    if (SDL_HasAVX2()) return SIMD_AVX2;
+    if (SDL_HasSSE2()) return SIMD_SSE2;
+#elif defined(SIMD_ARM)
+    if (SDL_HasNEON()) return SIMD_NEON;
+#endif
+    return SIMD_SCALAR;
+}
+
+// Parse a --simd argument; unsupported levels fall back to the detected one
+inline bool parseSimdLevel(const char* name, SimdLevel& level) {
+    SimdLevel best = detectSimdLevel();
+    SimdLevel wanted;
+    if (strcmp(name, "scalar") == 0) wanted = SIMD_SCALAR;
+    else if (strcmp(name, "sse2") == 0) wanted = SIMD_SSE2;
+    else if (strcmp(name, "avx2") == 0) wanted = SIMD_AVX2;
+    else if (strcmp(name, "neon") == 0) wanted = SIMD_NEON;
+    else if (strcmp(name, "auto") == 0) wanted = best;
+    else return false;
+    bool supported = wanted == SIMD_SCALAR || wanted == best ||
+                     (wanted == SIMD_SSE2 && best == SIMD_AVX2);
+    if (!supported) {
+        SDL_Log("SIMD level '%s' is not supported on this CPU, using '%s'", name, simdLevelName(best));
+        wanted = best;
+    }
+    level = wanted;
+    return true;
+}
+
+// Kernels are written once against GCC/Clang vector types and instantiated in
+// functions compiled for each instruction set, so helpers must always inline.
+#define SIMD_INLINE __attribute__((always_inline)) inline
+#if defined(SIMD_X86)
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+typedef float f32x4 __attribute__((vector_size(16)));
+typedef Sint32 i32x4 __attribute__((vector_size(16)));
+typedef float f32x8 __attribute__((vector_size(32)));
+typedef Sint32 i32x8 __attribute__((vector_size(32)));
+typedef Uint16 u16x4 __attribute__((vector_size(8)));
+typedef Uint16 u16x8 __attribute__((vector_size(16)));
+typedef Uint8 u8x4 __attribute__((vector_size(4)));
+typedef Uint8 u8x8 __attribute__((vector_size(8)));
+typedef Uint8 u8x16 __attribute__((vector_size(16)));
+typedef Uint8 u8x32 __attribute__((vector_size(32)));
+
+#if defined(__GNUC__) && !defined(__clang__)
+// 256-bit vectors only ever cross the always-inline helpers inside AVX2
+// functions; helpers take them by reference so no call ABI is involved.
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+template <class F> SIMD_INLINE F simdLoad(const float* p) {
+    F v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Load lanes of 16-bit fixed point and widen them to float
+template <class F, class H> SIMD_INLINE F simdLoadU16(const Uint16* p) {
+    H v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_convertvector(v, F);
+}
+
+template <class I> SIMD_INLINE void simdStore(Uint32* p, const I& v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+// Store the low byte of each lane (lanes already in [0, 255]). A byte
+// shuffle, because __builtin_convertvector to bytes is scalarized by GCC.
+SIMD_INLINE void simdStoreU8(Uint8* p, const i32x4& v) {
+    u8x4 bytes = __builtin_shufflevector((u8x16)v, (u8x16)v, 0, 4, 8, 12);
+    memcpy(p, &bytes, sizeof(bytes));
+}
+
+SIMD_INLINE void simdStoreU8(Uint8* p, const i32x8& v) {
+    u8x8 bytes = __builtin_shufflevector((u8x32)v, (u8x32)v, 0, 4, 8, 12, 16, 20, 24, 28);
+    memcpy(p, &bytes, sizeof(bytes));
+}
+
+// Lane i holds i, for building per-lane coordinates
+template <class F> SIMD_INLINE F simdRamp() {
+    F v;
+    for (int i = 0; i < (int)(sizeof(F) / sizeof(float)); ++i) v[i] = (float)i;
+    return v;
+}
+
+template <class F> SIMD_INLINE F simdSplat(float c) {
+    F v = {};
+    return v + c;
+}
+
+template <class F, class I> SIMD_INLINE F simdFloor(const F& x) {
+    F t = __builtin_convertvector(__builtin_convertvector(x, I), F);
+    return x < t ? t - 1.0f : t;
+}
+
+template <class F> SIMD_INLINE F simdAbs(const F& x) {
+    return x < 0.0f ? -x : x;
+}
+
+template <class F> SIMD_INLINE F simdMin(const F& a, const F& b) {
+    return a < b ? a : b;
+}
+
+template <class F> SIMD_INLINE F simdMax(const F& a, const F& b) {
+    return a > b ? a : b;
+}
+
+// sin(x), |error| < 1e-6 after reduction to [-pi/2, pi/2]
+template <class F, class I> SIMD_INLINE F simdSin(const F& angle) {
+    const float twoPiHi = 6.28125f;
+    const float twoPiLo = 1.9353071795864769e-3f;
+    const float halfPi = 1.5707963267948966f;
+    const float pi = 3.1415926535897932f;
+    F k = simdFloor<F, I>(angle * 0.15915494309189535f + 0.5f);
+    F x = angle - k * twoPiHi;
+    x = x - k * twoPiLo;
+    x = x > halfPi ? pi - x : x;
+    x = x < -halfPi ? -pi - x : x;
+    F x2 = x * x;
+    F p = simdSplat<F>(-2.5052108385441720e-8f);
+    p = p * x2 + 2.7557319223985893e-6f;
+    p = p * x2 - 1.9841269841269841e-4f;
+    p = p * x2 + 8.3333333333333333e-3f;
+    p = p * x2 - 1.6666666666666667e-1f;
+    return x + x * x2 * p;
+}
+
+// atan2(y, x), |error| < 2e-5 rad; atan2(0, 0) is 0 like atan2f
+template <class F> SIMD_INLINE F simdAtan2(const F& y, const F& x) {
+    const float halfPi = 1.5707963267948966f;
+    const float pi = 3.1415926535897932f;
+    F ax = simdAbs(x);
+    F ay = simdAbs(y);
+    F a = simdMin(ax, ay) / simdMax(simdMax(ax, ay), simdSplat<F>(1e-30f));
+    F s = a * a;
+    F p = simdSplat<F>(-0.01172120f);
+    p = p * s + 0.05265332f;
+    p = p * s - 0.11643287f;
+    p = p * s + 0.19354346f;
+    p = p * s - 0.33262347f;
+    p = p * s + 0.99997726f;
+    p = p * a;
+    p = ay > ax ? halfPi - p : p;
+    p = x < 0.0f ? pi - p : p;
+    return y < 0.0f ? -p : p;
+}
+
+// exp(x) for x in roughly [-87, 0], relative error < 2e-7
+template <class F, class I> SIMD_INLINE F simdExp(const F& x) {
+    const float ln2Hi = 0.693145751953125f;
+    const float ln2Lo = 1.428606765330187e-6f;
+    F n = simdFloor<F, I>(x * 1.4426950408889634f + 0.5f);
+    F f = x - n * ln2Hi;
+    f = f - n * ln2Lo;
+    F p = simdSplat<F>(1.0f / 720.0f);
+    p = p * f + 1.0f / 120.0f;
+    p = p * f + 1.0f / 24.0f;
+    p = p * f + 1.0f / 6.0f;
+    p = p * f + 0.5f;
+    p = p * f + 1.0f;
+    p = p * f + 1.0f;
+    I bits = (__builtin_convertvector(n, I) + 127) << 23;
+    return p * (F)bits;
+}
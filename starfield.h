@@ -0,0 +1,263 @@
+// starfield.h
+// Structure-of-arrays starfield: parallel update/projection, stars drawn in a few batched calls
+// or plotted straight into a background texture
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "rng.h"
+#include "thread_pool.h"
+
+const int STAR_BUCKETS = 16;        // brightness levels, one SDL_RenderDrawPoints call each
+const int STAR_CHUNK = 16384;       // stars per parallel task
+const Uint16 STAR_HIDDEN = 0xFFFF;  // sort key of a star that is not drawn this frame
+const int STAR_BAND_ROWS = 8;       // texture rows per splat band
+
+// Star color is base + range * brightness, brightness growing as the star comes closer
+struct StarfieldStyle {
+    float base;
+    float range;
+};
+
+struct StarOptions {
+    int count = 0;          // --stars N: overrides the effect's default star count
+    bool splat = false;     // --star-mode renderer|splat: draw points or plot into the background texture
+    bool additive = false;  // --additive: splatted stars add to the background instead of covering it
+};
+
+inline bool parseStarOptions(int argc, char* argv[], StarOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(argv[i], "--stars") == 0 && value) {
+            options.count = atoi(value);
+            ++i;
+            if (options.count <= 0) {
+                SDL_Log("Invalid star count '%s'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--star-mode") == 0 && value) {
+            ++i;
+            if (strcmp(value, "splat") == 0) {
+                options.splat = true;
+            } else if (strcmp(value, "renderer") == 0) {
+                options.splat = false;
+            } else {
+                SDL_Log("Unknown star mode '%s', expected 'renderer' or 'splat'", value);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--additive") == 0) {
+            options.additive = true;
+        }
+    }
+    return true;
+}
+
+struct Starfield {
+    int count = 0;
+    int width = 0;
+    int height = 0;
+    StarfieldStyle style = {0.0f, 255.0f};
+    Uint64 seed = 1;
+    Uint32 frame = 0;
+    // Visible stars are sorted either into STAR_BUCKETS brightness buckets for
+    // drawStarfield, or into bands of texture rows for splatStarRows
+    int bandDivisor = 0;              // texture at 1/bandDivisor resolution, 0 = brightness buckets
+    int keyCount = STAR_BUCKETS;
+    std::vector<float> x, y, z;
+    std::vector<float> sx, sy;        // projected position this frame
+    std::vector<Uint16> key;          // bucket or band this frame, or STAR_HIDDEN
+    std::vector<Uint32> packed;       // packed texture position and bucket this frame, when banded
+    std::vector<int> chunkCounts;     // stars per key in each chunk, then each chunk's write offset
+    std::vector<SDL_Point> points;    // visible stars grouped by bucket
+    std::vector<Uint32> splats;       // visible stars grouped by band: x | row in band << 16 | bucket << 24
+    std::vector<int> keyStart;        // first point of each key, plus the total
+};
+
+inline int starfieldChunks(const Starfield& field) {
+    return (field.count + STAR_CHUNK - 1) / STAR_CHUNK;
+}
+
+// Sort by brightness (divisor 0) or by band of a background texture at 1/divisor resolution
+inline void setStarfieldBands(Starfield& field, int divisor) {
+    field.bandDivisor = divisor;
+    if (divisor > 0) {
+        int textureHeight = (field.height + divisor - 1) / divisor;
+        field.keyCount = (textureHeight + STAR_BAND_ROWS - 1) / STAR_BAND_ROWS;
+        field.packed.resize(field.count);
+        field.splats.resize(field.count);
+    } else {
+        field.keyCount = STAR_BUCKETS;
+    }
+    field.chunkCounts.assign((size_t)starfieldChunks(field) * field.keyCount, 0);
+    field.keyStart.assign(field.keyCount + 1, 0);
+}
+
+inline void respawnStar(Starfield& field, int i, Rng& rng) {
+    field.x[i] = (float)((int)rng.below(field.width) - field.width / 2);
+    field.y[i] = (float)((int)rng.below(field.height) - field.height / 2);
+}
+
+inline void initStarfield(Starfield& field, int count, int width, int height, const StarfieldStyle& style,
+                          Uint64 seed) {
+    field.count = count;
+    field.width = width;
+    field.height = height;
+    field.style = style;
+    field.seed = deriveSeed(seed, "stars");
+    field.x.resize(count);
+    field.y.resize(count);
+    field.z.resize(count);
+    field.sx.resize(count);
+    field.sy.resize(count);
+    field.key.resize(count);
+    field.points.resize(count);
+    setStarfieldBands(field, 0);
+    Rng rng(field.seed);
+    for (int i = 0; i < count; ++i) {
+        respawnStar(field, i, rng);
+        field.z[i] = (float)rng.below(width);
+    }
+}
+
+// Move every star dz closer, project it and sort the visible ones by key;
+// a star that passes the camera or leaves the screen respawns at the far plane.
+inline void updateStarfield(Starfield& field, float dz, ThreadPool& pool) {
+    const float halfW = (float)(field.width / 2);
+    const float halfH = (float)(field.height / 2);
+    const float farPlane = (float)field.width;
+    const int divisor = field.bandDivisor;
+    // py / divisor as a multiply and shift, exact for coordinates below 32768
+    const Uint32 reciprocal = divisor ? 65536 / divisor + 1 : 0;
+    const int keys = field.keyCount;
+    ++field.frame;
+    int chunks = starfieldChunks(field);
+    pool.parallelFor(chunks, 1, [&](int c0, int c1) {
+        for (int c = c0; c < c1; ++c) {
+            int begin = c * STAR_CHUNK;
+            int end = begin + STAR_CHUNK < field.count ? begin + STAR_CHUNK : field.count;
+            float* x = field.x.data();
+            float* y = field.y.data();
+            float* z = field.z.data();
+            float* sx = field.sx.data();
+            float* sy = field.sy.data();
+            // Branch-free so the compiler vectorizes the divisions
+            for (int i = begin; i < end; ++i) {
+                z[i] -= dz;
+                float inv = 1.0f / z[i];
+                sx[i] = x[i] * inv * halfW + halfW;
+                sy[i] = y[i] * inv * halfH + halfH;
+            }
+            // One stream per chunk and frame, so respawns don't depend on the thread count
+            Rng rng(field.seed, (Uint64)field.frame * chunks + c);
+            int* counts = &field.chunkCounts[(size_t)c * keys];
+            memset(counts, 0, keys * sizeof(int));
+            for (int i = begin; i < end; ++i) {
+                if (z[i] <= 1) {
+                    respawnStar(field, i, rng);
+                    z[i] = farPlane;
+                    sx[i] = x[i] / farPlane * halfW + halfW;
+                    sy[i] = y[i] / farPlane * halfH + halfH;
+                }
+                int px = (int)sx[i];
+                int py = (int)sy[i];
+                if (px < 0 || px >= field.width || py < 0 || py >= field.height) {
+                    respawnStar(field, i, rng);
+                    z[i] = farPlane;
+                    field.key[i] = STAR_HIDDEN;
+                    continue;
+                }
+                float brightness = 1.0f - z[i] / farPlane;
+                if (brightness < 0) brightness = 0;
+                if (brightness > 1) brightness = 1;
+                int b = (int)(brightness * (STAR_BUCKETS - 1) + 0.5f);
+                int k = b;
+                if (divisor) {
+                    Uint32 tx = ((Uint32)px * reciprocal) >> 16;
+                    Uint32 ty = ((Uint32)py * reciprocal) >> 16;
+                    k = (int)(ty / STAR_BAND_ROWS);
+                    field.packed[i] = tx | (ty % STAR_BAND_ROWS) << 16 | (Uint32)b << 24;
+                }
+                field.key[i] = (Uint16)k;
+                ++counts[k];
+            }
+        }
+    });
+    // Prefix sums give every chunk its write offset inside each key
+    int total = 0;
+    for (int k = 0; k < keys; ++k) {
+        field.keyStart[k] = total;
+        for (int c = 0; c < chunks; ++c) {
+            int& n = field.chunkCounts[(size_t)c * keys + k];
+            int offset = total;
+            total += n;
+            n = offset;
+        }
+    }
+    field.keyStart[keys] = total;
+    pool.parallelFor(chunks, 1, [&](int c0, int c1) {
+        for (int c = c0; c < c1; ++c) {
+            int begin = c * STAR_CHUNK;
+            int end = begin + STAR_CHUNK < field.count ? begin + STAR_CHUNK : field.count;
+            int* offsets = &field.chunkCounts[(size_t)c * keys];
+            for (int i = begin; i < end; ++i) {
+                Uint16 k = field.key[i];
+                if (k == STAR_HIDDEN) continue;
+                int slot = offsets[k]++;
+                if (divisor) {
+                    field.splats[slot] = field.packed[i];
+                } else {
+                    field.points[slot] = {(int)field.sx[i], (int)field.sy[i]};
+                }
+            }
+        }
+    });
+}
+
+inline Uint8 starColor(const Starfield& field, int bucket) {
+    return (Uint8)(field.style.base + field.style.range * bucket / (STAR_BUCKETS - 1));
+}
+
+// One color change and one SDL_RenderDrawPoints call per non-empty bucket
+inline void drawStarfield(SDL_Renderer* renderer, const Starfield& field) {
+    for (int b = 0; b < STAR_BUCKETS; ++b) {
+        int n = field.keyStart[b + 1] - field.keyStart[b];
+        if (n == 0) continue;
+        Uint8 color = starColor(field, b);
+        SDL_SetRenderDrawColor(renderer, color, color, color, 255);
+        SDL_RenderDrawPoints(renderer, &field.points[field.keyStart[b]], n);
+    }
+}
+
+// Plot the stars of a banded starfield that fall in texture rows [row0, row1)
+// of an RGB888 buffer. row0 must start a band and row1 end one (or be the
+// texture height), which parallelFor with grain STAR_BAND_ROWS guarantees, so
+// the workers that shade the background can plot its stars without locking.
+inline void splatStarRows(const Starfield& field, int row0, int row1, Uint32* pixels, int pitchPixels, bool additive) {
+    Uint32 gray[STAR_BUCKETS];
+    for (int b = 0; b < STAR_BUCKETS; ++b) {
+        gray[b] = starColor(field, b) * 0x010101u;
+    }
+    int band0 = row0 / STAR_BAND_ROWS;
+    int band1 = (row1 + STAR_BAND_ROWS - 1) / STAR_BAND_ROWS;
+    if (band1 > field.keyCount) band1 = field.keyCount;
+    for (int band = band0; band < band1; ++band) {
+        Uint32* bandPixels = pixels + (size_t)band * STAR_BAND_ROWS * pitchPixels;
+        for (int i = field.keyStart[band]; i < field.keyStart[band + 1]; ++i) {
+            Uint32 splat = field.splats[i];
+            Uint32* p = bandPixels + ((splat >> 16) & 0xFF) * pitchPixels + (splat & 0xFFFF);
+            Uint32 color = gray[splat >> 24];
+            if (!additive) {
+                *p = color;
+                continue;
+            }
+            // Saturating add per channel: red/blue and green each get a spare byte
+            // to carry into, and a carry turns its channel to 255
+            Uint32 rb = (*p & 0xFF00FF) + (color & 0xFF00FF);
+            Uint32 g = (*p & 0x00FF00) + (color & 0x00FF00);
+            rb = (rb | ((rb >> 8) & 0x010001) * 0xFF) & 0xFF00FF;
+            g = (g | ((g >> 8) & 0x000100) * 0xFF) & 0x00FF00;
+            *p = rb | g;
+        }
+    }
+}
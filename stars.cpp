@@ -2,104 +2,57 @@
 #include <SDL2/SDL.h>
 #include <cmath>
 #include <cstdlib>
-#include <ctime>
+#include <string>
+#include "effect.h"
+#include "starfield.h"
 
-const int NUM_STARS = 2000;
+namespace stars {
 
-struct Star {
-    float x, y, z;
-};
-
-void initStar(Star& star, int screenWidth, int screenHeight) {
-    star.x = (float)(rand() % screenWidth - screenWidth / 2);
-    star.y = (float)(rand() % screenHeight - screenHeight / 2);
-    star.z = (float)(rand() % screenWidth);
-}
+const int NUM_STARS = 2000; // default for --stars
 
-int main(int argc, char* argv[]) {
-    srand((unsigned int)time(nullptr));
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        SDL_Log("SDL could not initialize! SDL_Error: %s", SDL_GetError());
-        return 1;
-    }
+struct StarsEffect : Effect {
+    StarOptions starOptions;
+    Starfield field;
+    float speed = 10.0f;
 
-    SDL_DisplayMode displayMode;
-    if (SDL_GetCurrentDisplayMode(0, &displayMode) != 0) {
-        SDL_Log("Could not get display mode! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
-    }
-    int screenWidth = displayMode.w;
-    int screenHeight = displayMode.h;
+    const char* name() const override { return "stars"; }
 
-    SDL_Window* window = SDL_CreateWindow(
-        "Starfield Effect",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        screenWidth,
-        screenHeight,
-        SDL_WINDOW_FULLSCREEN
-    );
-    if (!window) {
-        SDL_Log("Window could not be created! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
+    bool init(EffectContext& ctx) override {
+        starOptions.count = NUM_STARS;
+        if (!parseStarOptions(ctx.argc, ctx.argv, starOptions)) {
+            return false;
+        }
+        initStarfield(field, starOptions.count, ctx.kiosk.width, ctx.kiosk.height, {0.0f, 255.0f}, ctx.options.seed);
+        ctx.bench.addField("stars", std::to_string(starOptions.count));
+        return true;
     }
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    bool resize(EffectContext&) override { return true; }
 
-    // Kiosk-like settings
-    SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
-    SDL_SetWindowBordered(window, SDL_FALSE);
-    SDL_SetWindowAlwaysOnTop(window, SDL_TRUE);
-    SDL_SetWindowGrab(window, SDL_TRUE);
-    SDL_ShowCursor(SDL_DISABLE);
-    SDL_RaiseWindow(window);
-    SDL_SetHint(SDL_HINT_GRAB_KEYBOARD, "1");
-    SDL_SetWindowInputFocus(window);
-
-    Star stars[NUM_STARS];
-    for (int i = 0; i < NUM_STARS; ++i) {
-        initStar(stars[i], screenWidth, screenHeight);
+    void update(EffectContext& ctx) override {
+        TraceScope scope(ctx.trace, STAGE_COMPUTE);
+        updateStarfield(field, speed * ctx.scheduler.step(), ctx.pool);
     }
 
-    bool quit = false;
-    SDL_Event e;
-    float speed = 10.0f;
-    while (!quit) {
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) {
-                quit = true;
-            }
+    void render(EffectContext& ctx) override {
+        SDL_Renderer* renderer = ctx.kiosk.renderer;
+        {
+            TraceScope scope(ctx.trace, STAGE_COPY);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            SDL_RenderClear(renderer);
         }
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
-        for (int i = 0; i < NUM_STARS; ++i) {
-            Star& s = stars[i];
-            s.z -= speed;
-            if (s.z <= 1) {
-                initStar(s, screenWidth, screenHeight);
-                s.z = (float)screenWidth;
-            }
-            int sx = (int)((s.x / s.z) * (screenWidth / 2) + screenWidth / 2);
-            int sy = (int)((s.y / s.z) * (screenHeight / 2) + screenHeight / 2);
-            if (sx < 0 || sx >= screenWidth || sy < 0 || sy >= screenHeight) {
-                initStar(s, screenWidth, screenHeight);
-                s.z = (float)screenWidth;
-                continue;
-            }
-            float brightness = 1.0f - (s.z / screenWidth);
-            if (brightness < 0) brightness = 0;
-            if (brightness > 1) brightness = 1;
-            Uint8 color = (Uint8)(brightness * 255);
-            SDL_SetRenderDrawColor(renderer, color, color, color, 255);
-            SDL_RenderDrawPoint(renderer, sx, sy);
-        }
-        SDL_RenderPresent(renderer);
-        SDL_Delay(16);
+        TraceScope scope(ctx.trace, STAGE_DRAW);
+        drawStarfield(renderer, field);
     }
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
-    return 0;
+
+    void release(EffectContext&) override {}
+};
+
+} // namespace stars
+
+#ifndef KIOSK_HOST
+int main(int argc, char* argv[]) {
+    stars::StarsEffect effect;
+    return runEffect(effect, "Starfield Effect", argc, argv);
 }
+#endif
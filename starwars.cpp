@@ -3,9 +3,35 @@
 #include <SDL2/SDL.h>
 #include <cmath>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "accumulation.h"
+#include "adaptive_resolution.h"
+#include "effect.h"
+#include "galaxy.h"
+#include "quad_batch.h"
+#include "raster.h"
+#include "rng.h"
 
-const int NUM_STARS = 2000;
+namespace starwars {
+
+const int NUM_STARS = 2000; // default for --stars
+const float STAR_SPEED = 40.0f; // default for --speed, depth units per 60 Hz frame
+const int GALAXY_STEP = 4; // background sample spacing in pixels
+const float STREAK_FADE = 40.0f; // --trails: alpha of the black fill per 60 Hz frame
+const float STREAK_WIDTH = 1.5f; // pixels
+const Uint8 STREAK_TAIL_ALPHA = 48; // streaks brighten from tail to head
+
+// Phase lengths in 60 Hz frames, the frame counts of the original loop. Like the
+// star speed and the condense pull, they are taken at 60 Hz, so the streaks cover
+// the same depth as there; hyperspace lasts about 1.7 s.
+const double HYPERSPACE_FRAMES = 100;
+const double CONDENSE_FRAMES = 80;   // or until every star has arrived
+const double APPROACH_FRAMES = 120;  // a cap; the core grows to full size in about 28 at 1080 lines
+
+// Much fainter than the plasma_stars galaxy so the streaks stay in front
+const GalaxyStyle HYPERSPACE_GALAXY = {0.08f, 0.25f, 40.0f, 20.0f, 90.0f, 30.0f};
 
 struct Star {
     float x, y, z, pz;
@@ -14,94 +40,133 @@ struct Star {
 int screenWidth = 0;
 int screenHeight = 0;
 
-void initStar(Star& star) {
-    star.x = (float)(rand() % screenWidth - screenWidth / 2);
-    star.y = (float)(rand() % screenHeight - screenHeight / 2);
-    star.z = (float)(screenWidth * 0.5f + rand() % (screenWidth / 2));
+void initStar(Star& star, Rng& rng) {
+    star.x = (float)((int)rng.below(screenWidth) - screenWidth / 2);
+    star.y = (float)((int)rng.below(screenHeight) - screenHeight / 2);
+    star.z = (float)(screenWidth * 0.5f + rng.below(screenWidth / 2));
     star.pz = star.z;
 }
 
-int main(int argc, char* argv[]) {
-    srand((unsigned int)time(nullptr));
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        SDL_Log("SDL could not initialize! SDL_Error: %s", SDL_GetError());
-        return 1;
-    }
+struct StarWarsEffect : Effect {
+    GalaxyEngine galaxyEngine = GALAXY_CACHED;
+    bool cpuDecay = false;
+    bool trails = false;  // --trails: streaks persist and fade in an accumulation frame
+    Rng rng;
+    int starCount = NUM_STARS;
+    std::vector<Star> stars;
+    float speed = STAR_SPEED;
+    bool inHyperspace = true;
+    bool condensePhase = false;
+    bool approachPhase = false;
+    bool showDeathStar = false;
+    double phaseStart = 0; // scheduler time the current phase began
+    float condenseX = 0;
+    float condenseY = 0;
+    float condenseRadius = 8.0f;
+    float approachRadius = 0;
+    // Galaxy samples are shaded in parallel straight into a streaming texture
+    // at 1/GALAXY_STEP resolution, which is stretched over the screen
+    int galaxyRows = 0;
+    GalaxyField field;
+    SDL_Texture* galaxyTexture = nullptr;
+    bool galaxyValid = false;  // a fresh texture has to be shaded even under load
+    QuadBatch streaks;         // one gradient quad per star, drawn in one call
+    std::vector<SDL_Point> points;  // condensing stars
+    SpanBatch spans;  // condense core and Death Star, one color at a time
+    Accumulator acc;
 
-    SDL_DisplayMode displayMode;
-    if (SDL_GetCurrentDisplayMode(0, &displayMode) != 0) {
-        SDL_Log("Could not get display mode! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
+    const char* name() const override { return "starwars"; }
+
+    bool init(EffectContext& ctx) override {
+        if (!parseGalaxyEngine(ctx.argc, ctx.argv, galaxyEngine) || !parseDecayMode(ctx.argc, ctx.argv, cpuDecay)) {
+            return false;
+        }
+        for (int i = 1; i < ctx.argc; ++i) {
+            const char* value = i + 1 < ctx.argc ? ctx.argv[i + 1] : nullptr;
+            if (strcmp(ctx.argv[i], "--trails") == 0) {
+                trails = true;
+            } else if (strcmp(ctx.argv[i], "--stars") == 0 && value) {
+                starCount = atoi(value);
+                ++i;
+                if (starCount <= 0) {
+                    SDL_Log("Invalid star count '%s'", value);
+                    return false;
+                }
+            } else if (strcmp(ctx.argv[i], "--speed") == 0 && value) {
+                speed = (float)atof(value);
+                ++i;
+                if (speed <= 0) {
+                    SDL_Log("Invalid star speed '%s'", value);
+                    return false;
+                }
+            }
+        }
+        screenWidth = ctx.kiosk.width;
+        screenHeight = ctx.kiosk.height;
+        rng = Rng(deriveSeed(ctx.options.seed, "starwars"));
+        stars.resize(starCount);
+        galaxyRows = (screenHeight + GALAXY_STEP - 1) / GALAXY_STEP;
+        buildGalaxyEngineField(galaxyEngine, field, screenWidth, screenHeight, GALAXY_STEP, ctx.pool);
+        ctx.bench.addField("galaxy", galaxyEngineName(galaxyEngine));
+        ctx.bench.addField("stars", std::to_string(starCount));
+        ctx.bench.addField("trails", !trails ? "off" : cpuDecay ? "cpu" : "gpu");
+        return true;
     }
-    screenWidth = displayMode.w;
-    screenHeight = displayMode.h;
-
-    SDL_Window* window = SDL_CreateWindow(
-        "Star Wars Hyperspace",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        screenWidth,
-        screenHeight,
-        SDL_WINDOW_FULLSCREEN
-    );
-    if (!window) {
-        SDL_Log("Window could not be created! SDL_Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
+
+    bool resize(EffectContext& ctx) override {
+        if (galaxyTexture) SDL_DestroyTexture(galaxyTexture);
+        galaxyTexture = createBackgroundTexture(ctx.kiosk.renderer, screenWidth, screenHeight, GALAXY_STEP, true);
+        galaxyValid = false;
+        destroyAccumulator(acc);
+        return galaxyTexture &&
+               (!trails || createAccumulator(ctx.kiosk.renderer, screenWidth, screenHeight, cpuDecay, acc));
     }
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-
-    // Kiosk-like settings
-    SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
-    SDL_SetWindowBordered(window, SDL_FALSE);
-    SDL_SetWindowAlwaysOnTop(window, SDL_TRUE);
-    SDL_SetWindowGrab(window, SDL_TRUE);
-    SDL_ShowCursor(SDL_DISABLE);
-    SDL_RaiseWindow(window);
-    SDL_SetHint(SDL_HINT_GRAB_KEYBOARD, "1");
-    SDL_SetWindowInputFocus(window);
-
-    Star stars[NUM_STARS];
-    for (int i = 0; i < NUM_STARS; ++i) {
-        initStar(stars[i]);
+    // Every showing starts the sequence over with fresh hyperspace stars
+    void show(EffectContext& ctx) override {
+        for (Star& star : stars) {
+            initStar(star, rng);
+        }
+        inHyperspace = true;
+        condensePhase = false;
+        approachPhase = false;
+        showDeathStar = false;
+        phaseStart = ctx.scheduler.time;
+        condenseX = screenWidth / 2.0f;
+        condenseY = screenHeight / 2.0f;
+        if (trails) {
+            clearAccumulator(ctx.kiosk.renderer, acc);
+        }
     }
 
-    bool quit = false;
-    SDL_Event e;
-    float speed = 40.0f;
-    int t = 0;
-    bool inHyperspace = true;
-    bool condensePhase = false;
-    bool approachPhase = false;
-    bool showDeathStar = false;
-    int hyperspaceFrames = 100; // ~2.5 seconds
-    int condenseFrames = 80;    // ~0.8 seconds
-    int approachFrames = 120;   // ~1.2 seconds
-    float condenseX = screenWidth / 2.0f;
-    float condenseY = screenHeight / 2.0f;
-    float condenseRadius = 8.0f;
-    float approachRadius = screenHeight * 0.32f;
+    void event(EffectContext& ctx, const SDL_Event& e) override {
+        if (e.type == SDL_RENDER_TARGETS_RESET) {
+            galaxyValid = false;
+            if (trails) clearAccumulator(ctx.kiosk.renderer, acc);
+        }
+    }
 
-    while (!quit) {
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) {
-                quit = true;
+    // Fly every star toward the viewer; respawns draw from the rng in star order,
+    // so this stays sequential and seeded runs repeat
+    void moveStars(float step) {
+        for (Star& s : stars) {
+            s.pz = s.z;
+            s.z -= speed * step;
+            if (s.z < 1) {
+                initStar(s, rng);
+                s.z = s.pz = (float)screenWidth;
             }
         }
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
-        if (inHyperspace) {
-            // Draw hyperspace stars
-            for (int i = 0; i < NUM_STARS; ++i) {
-                Star& s = stars[i];
-                s.pz = s.z;
-                s.z -= speed;
-                if (s.z < 1) {
-                    initStar(s);
-                    s.z = s.pz = (float)screenWidth;
-                }
+    }
+
+    // One quad per star from its previous to its current projected position,
+    // brighter for nearer stars; workers fill their own slices of the batch
+    void buildStreaks(ThreadPool& pool) {
+        streaks.vertices.resize(stars.size() * 4);
+        SDL_Vertex* vertices = streaks.vertices.data();
+        pool.parallelFor((int)stars.size(), 1024, [&](int i0, int i1) {
+            for (int i = i0; i < i1; ++i) {
+                const Star& s = stars[i];
                 float sx = (s.x / s.z) * (screenWidth / 2) + screenWidth / 2;
                 float sy = (s.y / s.z) * (screenHeight / 2) + screenHeight / 2;
                 float px = (s.x / s.pz) * (screenWidth / 2) + screenWidth / 2;
@@ -110,136 +175,171 @@ int main(int argc, char* argv[]) {
                 if (brightness < 0) brightness = 0;
                 if (brightness > 1) brightness = 1;
                 Uint8 color = (Uint8)(200 + brightness * 55);
-                SDL_SetRenderDrawColor(renderer, color, color, color, 255);
-                SDL_RenderDrawLine(renderer, (int)px, (int)py, (int)sx, (int)sy);
+                setLineQuad(vertices + (size_t)i * 4, {px, py}, {sx, sy}, STREAK_WIDTH,
+                            {color, color, color, STREAK_TAIL_ALPHA}, {color, color, color, 255});
             }
-            // Faint galaxy background
-            for (int y = 0; y < screenHeight; y += 4) {
-                for (int x = 0; x < screenWidth; x += 4) {
-                    float cx = 0.5f * screenWidth;
-                    float cy = 0.5f * screenHeight;
-                    float dx = x - cx;
-                    float dy = y - cy;
-                    float r = sqrtf(dx * dx + dy * dy);
-                    float angle = atan2f(dy, dx);
-                    float spiral = sinf(4.0f * angle + r * 0.025f - t * 0.012f);
-                    float core = expf(-r * 0.002f);
-                    float arms = 0.5f + 0.5f * spiral;
-                    float brightness = 0.08f * core + 0.25f * arms * core;
-                    float c = brightness;
-                    Uint8 rC = (Uint8)(40 * c);
-                    Uint8 gC = (Uint8)(20 * c);
-                    Uint8 bC = (Uint8)(90 * c + 30 * core);
-                    SDL_SetRenderDrawColor(renderer, rC, gC, bC, 255);
-                    SDL_RenderDrawPoint(renderer, x, y);
+        });
+    }
+
+    // The phases move the stars while drawing them, so the whole sequence runs here
+    void render(EffectContext& ctx) override {
+        const KioskOptions& options = ctx.options;
+        FrameScheduler& scheduler = ctx.scheduler;
+        FrameTrace& trace = ctx.trace;
+        SDL_Renderer* renderer = ctx.kiosk.renderer;
+        float step = scheduler.step();
+        double phaseFrames = (scheduler.time - phaseStart) * ANIMATION_RATE;
+        {
+            TraceScope scope(trace, STAGE_COPY);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            SDL_RenderClear(renderer);
+        }
+        if (inHyperspace) {
+            // Faint galaxy background first so the streaks land on it; under load keep last frame's
+            if (!scheduler.degraded || !galaxyValid) {
+                GalaxyShade shade = makeGalaxyShade(galaxyEngine, options.simd, HYPERSPACE_GALAXY,
+                                                    galaxyTime(scheduler.frameTime()));
+                void* pixels;
+                int pitch;
+                {
+                    TraceScope scope(trace, STAGE_UPLOAD);
+                    SDL_LockTexture(galaxyTexture, NULL, &pixels, &pitch);
+                }
+                {
+                    TraceScope scope(trace, STAGE_COMPUTE);
+                    ctx.pool.parallelFor(galaxyRows, 8, [&](int row0, int row1) {
+                        for (int row = row0; row < row1; ++row) {
+                            Uint32* out = (Uint32*)pixels + (size_t)row * (pitch / 4);
+                            renderGalaxyEngineRow(shade, field, screenWidth, screenHeight, GALAXY_STEP, row, out);
+                        }
+                    });
                 }
+                {
+                    TraceScope scope(trace, STAGE_UPLOAD);
+                    SDL_UnlockTexture(galaxyTexture);
+                }
+                galaxyValid = true;
+            }
+            {
+                TraceScope scope(trace, STAGE_COPY);
+                SDL_RenderCopy(renderer, galaxyTexture, NULL, NULL);
+            }
+            {
+                TraceScope scope(trace, STAGE_COMPUTE);
+                moveStars(step);
+                buildStreaks(ctx.pool);
+            }
+            // Draw hyperspace stars; with trails each frame adds its segment to the faded earlier ones
+            if (trails) {
+                TraceScope scope(trace, STAGE_COPY);
+                beginAccumulation(renderer, acc, STREAK_FADE, step, options.simd, ctx.pool);
             }
-            --hyperspaceFrames;
-            if (hyperspaceFrames <= 0) {
+            {
+                TraceScope scope(trace, STAGE_DRAW);
+                SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_ADD);
+                drawQuadBatch(renderer, nullptr, streaks);
+                SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+            }
+            if (trails) {
+                TraceScope scope(trace, STAGE_COPY);
+                endAccumulation(renderer, acc, SDL_BLENDMODE_ADD);
+            }
+            if (phaseFrames >= HYPERSPACE_FRAMES) {
                 inHyperspace = false;
                 condensePhase = true;
+                phaseStart = scheduler.time;
             }
         } else if (condensePhase) {
+            TraceScope scope(trace, STAGE_DRAW);
             // Move all stars toward the center and draw them as a bright green object
             bool allArrived = true;
-            for (int i = 0; i < NUM_STARS; ++i) {
-                Star& s = stars[i];
+            float pull = 1.0f - powf(0.88f, step); // 12% of the distance per 60 Hz frame
+            points.clear();
+            for (Star& s : stars) {
                 float sx = (s.x / s.z) * (screenWidth / 2) + screenWidth / 2;
                 float sy = (s.y / s.z) * (screenHeight / 2) + screenHeight / 2;
                 float dx = condenseX - sx;
                 float dy = condenseY - sy;
                 float dist = sqrtf(dx * dx + dy * dy);
                 if (dist > condenseRadius) {
-                    sx += dx * 0.12f;
-                    sy += dy * 0.12f;
+                    sx += dx * pull;
+                    sy += dy * pull;
                     allArrived = false;
                 }
-                SDL_SetRenderDrawColor(renderer, 80, 255, 80, 255);
-                SDL_RenderDrawPoint(renderer, (int)sx, (int)sy);
+                points.push_back({(int)sx, (int)sy});
                 // Update star's position for next frame
                 s.x = (sx - screenWidth / 2) * s.z / (screenWidth / 2);
                 s.y = (sy - screenHeight / 2) * s.z / (screenHeight / 2);
             }
+            SDL_SetRenderDrawColor(renderer, 80, 255, 80, 255);
+            SDL_RenderDrawPoints(renderer, points.data(), (int)points.size());
             // Draw a very bright green core
             SDL_SetRenderDrawColor(renderer, 120, 255, 120, 255);
-            for (int y = -condenseRadius; y <= condenseRadius; ++y) {
-                for (int x = -condenseRadius; x <= condenseRadius; ++x) {
-                    if (x * x + y * y <= condenseRadius * condenseRadius) {
-                        SDL_RenderDrawPoint(renderer, (int)(condenseX + x), (int)(condenseY + y));
-                    }
-                }
-            }
-            --condenseFrames;
-            if (condenseFrames <= 0 || allArrived) {
+            addDiscSpans(spans, (int)condenseX, (int)condenseY, condenseRadius);
+            drawSpans(renderer, spans);
+            if (phaseFrames >= CONDENSE_FRAMES || allArrived) {
                 condensePhase = false;
                 approachPhase = true;
+                phaseStart = scheduler.time;
+                approachRadius = condenseRadius; // the condensed core grows into the Death Star
             }
         } else if (approachPhase) {
+            TraceScope scope(trace, STAGE_DRAW);
             // Animate the green core growing larger (approaching)
-            approachRadius += (screenHeight * 0.32f - approachRadius) * 0.12f + 1.0f;
+            approachRadius += (screenHeight * 0.32f - approachRadius) * (1.0f - powf(0.88f, step)) + step;
             SDL_SetRenderDrawColor(renderer, 120, 255, 120, 255);
-            for (int y = -approachRadius; y <= approachRadius; ++y) {
-                for (int x = -approachRadius; x <= approachRadius; ++x) {
-                    if (x * x + y * y <= approachRadius * approachRadius) {
-                        SDL_RenderDrawPoint(renderer, (int)(condenseX + x), (int)(condenseY + y));
-                    }
-                }
-            }
-            if (approachRadius >= screenHeight * 0.32f - 2.0f) {
+            addDiscSpans(spans, (int)condenseX, (int)condenseY, approachRadius);
+            drawSpans(renderer, spans);
+            if (approachRadius >= screenHeight * 0.32f - 2.0f || phaseFrames >= APPROACH_FRAMES) {
                 approachPhase = false;
                 showDeathStar = true;
             }
         } else if (showDeathStar) {
+            TraceScope scope(trace, STAGE_DRAW);
             // Draw the Death Star (greenish)
             float cx = screenWidth / 2.0f;
             float cy = screenHeight / 2.0f;
             float radius = screenHeight * 0.32f;
             // Main body
             SDL_SetRenderDrawColor(renderer, 120, 255, 120, 255);
-            for (int y = -radius; y <= radius; ++y) {
-                for (int x = -radius; x <= radius; ++x) {
-                    if (x * x + y * y <= radius * radius) {
-                        SDL_RenderDrawPoint(renderer, (int)(cx + x), (int)(cy + y));
-                    }
-                }
-            }
+            addDiscSpans(spans, (int)cx, (int)cy, radius);
+            drawSpans(renderer, spans);
             // Equatorial trench
             SDL_SetRenderDrawColor(renderer, 60, 180, 60, 255);
-            for (int y = -4; y <= 4; ++y) {
-                for (int x = -radius; x <= radius; ++x) {
-                    if ((x * x + y * y <= radius * radius) && (abs(y) < 4)) {
-                        SDL_RenderDrawPoint(renderer, (int)(cx + x), (int)(cy + y));
-                    }
-                }
-            }
+            addDiscBandSpans(spans, (int)cx, (int)cy, radius, -3, 3);
+            drawSpans(renderer, spans);
             // Superlaser dish
             float dishR = radius * 0.28f;
             float dishX = cx + radius * 0.38f;
             float dishY = cy - radius * 0.22f;
             SDL_SetRenderDrawColor(renderer, 40, 180, 40, 255);
-            for (int y = -dishR; y <= dishR; ++y) {
-                for (int x = -dishR; x <= dishR; ++x) {
-                    if (x * x + y * y <= dishR * dishR) {
-                        SDL_RenderDrawPoint(renderer, (int)(dishX + x), (int)(dishY + y));
-                    }
-                }
-            }
+            addDiscSpans(spans, (int)dishX, (int)dishY, dishR);
+            drawSpans(renderer, spans);
             // Dish highlight
             SDL_SetRenderDrawColor(renderer, 180, 255, 180, 255);
-            for (int y = -dishR/2; y <= dishR/2; ++y) {
-                for (int x = -dishR/2; x <= dishR/2; ++x) {
-                    if (x * x + y * y <= (dishR * dishR) / 4) {
-                        SDL_RenderDrawPoint(renderer, (int)(dishX + x - dishR/4), (int)(dishY + y - dishR/4));
-                    }
-                }
-            }
+            addDiscSpans(spans, (int)(dishX - dishR / 4), (int)(dishY - dishR / 4), dishR / 2);
+            drawSpans(renderer, spans);
         }
-        SDL_RenderPresent(renderer);
-        SDL_Delay(10);
-        ++t;
     }
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
-    return 0;
+
+    // The hyperspace galaxy at its sample spacing
+    void verify(VerifyRun& run) override {
+        verifyGalaxy(run, "starwars", HYPERSPACE_GALAXY, GALAXY_STEP);
+        verifyAnimationClock(run, "starwars", "clock/galaxy", GALAXY_PERIOD);
+    }
+
+    void release(EffectContext&) override {
+        if (galaxyTexture) SDL_DestroyTexture(galaxyTexture);
+        galaxyTexture = nullptr;
+        destroyAccumulator(acc);
+    }
+};
+
+} // namespace starwars
+
+#ifndef KIOSK_HOST
+int main(int argc, char* argv[]) {
+    starwars::StarWarsEffect effect;
+    return runEffect(effect, "Star Wars Hyperspace", argc, argv);
 }
+#endif
@@ -0,0 +1,112 @@
+// thread_pool.h
+// Persistent worker pool for the per-frame pixel loops
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Each thread owns a contiguous run of chunks; once its own run is drained it
+// steals the remaining chunks of the other threads through the same cursor.
+struct alignas(64) WorkQueue {
+    std::atomic<int> next{0};
+    int end = 0;
+};
+
+class ThreadPool {
+public:
+    // threads <= 1 runs every task on the calling thread
+    explicit ThreadPool(int threads)
+        : threadCount_(threads < 1 ? 1 : threads), queues_(new WorkQueue[threadCount_]) {
+        for (int i = 1; i < threadCount_; ++i) {
+            workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int threadCount() const { return threadCount_; }
+
+    // Run task(begin, end) over [0, count) in chunks of `grain` items. The
+    // calling thread works too, and the call returns once every chunk is done.
+    void parallelFor(int count, int grain, const std::function<void(int, int)>& task) {
+        if (count <= 0) return;
+        int chunks = (count + grain - 1) / grain;
+        if (threadCount_ == 1 || chunks == 1) {
+            task(0, count);
+            return;
+        }
+        for (int i = 0; i < threadCount_; ++i) {
+            queues_[i].next.store((int)((long long)chunks * i / threadCount_), std::memory_order_relaxed);
+            queues_[i].end = (int)((long long)chunks * (i + 1) / threadCount_);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            count_ = count;
+            grain_ = grain;
+            pending_ = threadCount_ - 1;
+            ++generation_;
+        }
+        wake_.notify_all();
+        runChunks(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+        task_ = nullptr;
+    }
+
+private:
+    void runChunks(int self) {
+        for (int k = 0; k < threadCount_; ++k) {
+            WorkQueue& queue = queues_[(self + k) % threadCount_];
+            for (int c = queue.next.fetch_add(1); c < queue.end; c = queue.next.fetch_add(1)) {
+                int begin = c * grain_;
+                int end = begin + grain_ < count_ ? begin + grain_ : count_;
+                (*task_)(begin, end);
+            }
+        }
+    }
+
+    void workerLoop(int self) {
+        unsigned seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+            }
+            runChunks(self);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) done_.notify_one();
+        }
+    }
+
+    int threadCount_;
+    std::unique_ptr<WorkQueue[]> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int, int)>* task_ = nullptr;
+    int count_ = 0;
+    int grain_ = 1;
+    int pending_ = 0;
+    unsigned generation_ = 0;
+    bool stop_ = false;
+};
@@ -0,0 +1,185 @@
+// verify.h
+// --verify: renders fixed frames with every fast kernel and compares them with the reference formulas
+#pragma once
+#include <SDL2/SDL.h>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "kiosk.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+// Animation times every kernel is checked at, in 60 Hz frame units; the large
+// ones (24 minutes and a day of uptime) expose precision loss in the time terms
+const float VERIFY_TIMES[] = {0.0f, 37.5f, 1000.25f, 86400.0f, 5184000.0f};
+const int VERIFY_TIME_COUNT = sizeof(VERIFY_TIMES) / sizeof(VERIFY_TIMES[0]);
+
+// Default sizes: a small frame, an odd one that exercises the vector tails, and 1080p
+const int VERIFY_SIZES[][2] = {{320, 200}, {333, 187}, {1920, 1080}};
+
+struct VerifyTolerance {
+    int maxError;    // largest difference in any channel of any pixel
+    double minPsnr;  // dB over all channels of all checked frames
+};
+
+// Every instruction set the CPU can run, scalar first
+inline std::vector<SimdLevel> verifySimdLevels() {
+    SimdLevel best = detectSimdLevel();
+    std::vector<SimdLevel> levels = {SIMD_SCALAR};
+    if (best == SIMD_AVX2) levels.push_back(SIMD_SSE2);
+    if (best != SIMD_SCALAR) levels.push_back(best);
+    return levels;
+}
+
+// FNV-1a over the pixel values, chained across frames
+inline Uint64 hashPixels(Uint64 hash, const Uint32* pixels, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        hash = (hash ^ pixels[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// One effect's kernels at one size: the reference frames are rendered first,
+// then each kernel renders the same times and is compared channel by channel.
+class VerifyRun {
+public:
+    using Shade = std::function<void(float t, Uint32* out)>;
+
+    explicit VerifyRun(const KioskOptions& options) : pool(options.threads), goldenPath_(options.goldenPath) {
+        if (options.width > 0) {
+            sizes.push_back({options.width, options.height});
+        } else {
+            for (const auto& size : VERIFY_SIZES) sizes.push_back({size[0], size[1]});
+        }
+        printf("%-12s %-10s %-22s %5s %9s %9s  %-16s %s\n", "effect", "size", "kernel", "max", "psnr_db", "ms",
+               "hash", "result");
+    }
+
+    ThreadPool pool;
+    std::vector<std::pair<int, int>> sizes;  // frame sizes to check, from --size or the defaults
+
+    // count is the number of samples shade() writes, which is less than
+    // width * height for effects that shade at reduced resolution
+    void reference(const char* effect, int width, int height, size_t count, const Shade& shade) {
+        effect_ = effect;
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", width, height);
+        size_ = size;
+        count_ = count;
+        reference_.assign(VERIFY_TIME_COUNT, std::vector<Uint32>(count));
+        Uint64 hash = 0xCBF29CE484222325ull;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < VERIFY_TIME_COUNT; ++i) {
+            shade(VERIFY_TIMES[i], reference_[i].data());
+        }
+        double ms = elapsedMs(start) / VERIFY_TIME_COUNT;
+        for (int i = 0; i < VERIFY_TIME_COUNT; ++i) {
+            hash = hashPixels(hash, reference_[i].data(), count);
+        }
+        record("reference", 0, INFINITY, ms, hash, true);
+    }
+
+    void kernel(const std::string& name, const VerifyTolerance& tolerance, const Shade& shade) {
+        std::vector<Uint32> out(count_);
+        Uint64 hash = 0xCBF29CE484222325ull;
+        int maxError = 0;
+        double squared = 0;
+        double ms = 0;
+        for (int i = 0; i < VERIFY_TIME_COUNT; ++i) {
+            Uint64 start = SDL_GetPerformanceCounter();
+            shade(VERIFY_TIMES[i], out.data());
+            ms += elapsedMs(start);
+            hash = hashPixels(hash, out.data(), count_);
+            const Uint32* ref = reference_[i].data();
+            for (size_t p = 0; p < count_; ++p) {
+                for (int shift = 0; shift < 24; shift += 8) {
+                    int d = (int)((out[p] >> shift) & 0xFF) - (int)((ref[p] >> shift) & 0xFF);
+                    if (d < 0) d = -d;
+                    if (d > maxError) maxError = d;
+                    squared += d * d;
+                }
+            }
+        }
+        double mse = squared / (3.0 * count_ * VERIFY_TIME_COUNT);
+        double psnr = mse > 0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+        bool ok = maxError <= tolerance.maxError && psnr >= tolerance.minPsnr;
+        record(name, maxError, psnr, ms / VERIFY_TIME_COUNT, hash, ok);
+    }
+
+    // A check without frames, e.g. of the animation clock, listed like a kernel
+    void check(const char* effect, const char* setup, const std::string& name, bool ok) {
+        effect_ = effect;
+        size_ = setup;
+        record(name, 0, INFINITY, 0, 0, ok);
+    }
+
+    // Check the hashes against --golden PATH (or record them if the file doesn't
+    // exist yet) and print the summary; true if every kernel passed
+    bool finish() {
+        if (!goldenPath_.empty()) checkGolden();
+        int failed = 0;
+        for (const Result& result : results_) failed += result.ok ? 0 : 1;
+        printf("%zu kernel checks, %d failed\n", results_.size(), failed);
+        fflush(stdout);
+        return failed == 0;
+    }
+
+private:
+    struct Result {
+        std::string key;  // "effect size kernel"
+        Uint64 hash;
+        bool ok;
+    };
+
+    static double elapsedMs(Uint64 start) {
+        return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
+    void record(const std::string& kernel, int maxError, double psnr, double ms, Uint64 hash, bool ok) {
+        printf("%-12s %-10s %-22s %5d %9.2f %9.3f  %016llx %s\n", effect_.c_str(), size_.c_str(), kernel.c_str(),
+               maxError, psnr, ms, (unsigned long long)hash, ok ? "ok" : "FAIL");
+        results_.push_back({effect_ + " " + size_ + " " + kernel, hash, ok});
+    }
+
+    // Golden hashes catch any change in output, also within tolerance. Float
+    // kernels depend on the compiler and libm, so record them per build setup.
+    void checkGolden() {
+        std::map<std::string, Uint64> golden;
+        if (FILE* file = fopen(goldenPath_.c_str(), "r")) {
+            char effect[64], size[32], kernel[64];
+            unsigned long long hash;
+            while (fscanf(file, "%63s %31s %63s %llx", effect, size, kernel, &hash) == 4) {
+                golden[std::string(effect) + " " + size + " " + kernel] = hash;
+            }
+            fclose(file);
+            for (Result& result : results_) {
+                auto it = golden.find(result.key);
+                if (it != golden.end() && it->second != result.hash) {
+                    printf("golden hash mismatch: %s\n", result.key.c_str());
+                    result.ok = false;
+                }
+            }
+            return;
+        }
+        FILE* file = fopen(goldenPath_.c_str(), "w");
+        if (!file) {
+            SDL_Log("Could not write golden hashes to '%s'", goldenPath_.c_str());
+            return;
+        }
+        for (const Result& result : results_) {
+            fprintf(file, "%s %016llx\n", result.key.c_str(), (unsigned long long)result.hash);
+        }
+        fclose(file);
+        printf("recorded %zu golden hashes in %s\n", results_.size(), goldenPath_.c_str());
+    }
+
+    std::string goldenPath_;
+    std::string effect_;
+    std::string size_;
+    size_t count_ = 0;
+    std::vector<std::vector<Uint32>> reference_;
+    std::vector<Result> results_;
+};